@@ -0,0 +1,144 @@
+/*
+ * Benchmark of opening pools: the latency of opening, and the resident
+ * memory, of the pools of the stress test, mem_pool_open against a
+ * plain calloc() of the same size (what a pool used to be backed by)
+ */
+
+#define _DEFAULT_SOURCE // for sysconf()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mem_pool.h"
+
+/*****            constants            *****/
+
+static const unsigned BENCH_NUM_POOLS       = 200;
+static const size_t   BENCH_POOL_SIZE       = 5005000; // as in the stress test
+static const size_t   BENCH_TOUCH_SIZE      = 65536; // used at the start of each pool
+static const unsigned BENCH_ROUNDS          = 3;
+
+
+/*****         helper routines         *****/
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// resident set size in KiB, 0 if it can't be read
+static long rss_kib() {
+    long size = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// bail out of the benchmark, as the numbers would be meaningless
+static void fail(const char *what, unsigned i) {
+    fprintf(stderr, "%s failed for pool %u\n", what, i);
+    exit(EXIT_FAILURE);
+}
+
+static void report(const char *backing, unsigned round,
+                   double open_us, long rss_base, long rss_open, long rss_touch) {
+    printf("%-14s %5u %14.2f %14ld %14ld\n",
+           backing, round, open_us / BENCH_NUM_POOLS,
+           rss_open - rss_base, rss_touch - rss_base);
+}
+
+
+/*****           benchmarks            *****/
+
+static void bench_calloc(unsigned round) {
+    char **mems = calloc(BENCH_NUM_POOLS, sizeof(char *));
+    if (mems == NULL)
+        fail("calloc", 0);
+    long rss_base = rss_kib();
+
+    double start = now_us();
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i) {
+        mems[i] = calloc(BENCH_POOL_SIZE, sizeof(char));
+        if (mems[i] == NULL)
+            fail("calloc", i);
+    }
+    double open_us = now_us() - start;
+    long rss_open = rss_kib();
+
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i)
+        memset(mems[i], 0xab, BENCH_TOUCH_SIZE);
+    long rss_touch = rss_kib();
+
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i)
+        free(mems[i]);
+    free(mems);
+
+    report("calloc", round, open_us, rss_base, rss_open, rss_touch);
+}
+
+static void bench_mem_pool(unsigned round) {
+    pool_pt *pools = calloc(BENCH_NUM_POOLS, sizeof(pool_pt));
+    if (pools == NULL)
+        fail("calloc", 0);
+    if (mem_init() != ALLOC_OK)
+        fail("mem_init", 0);
+    long rss_base = rss_kib();
+
+    double start = now_us();
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i) {
+        pools[i] = mem_pool_open(BENCH_POOL_SIZE, FIRST_FIT);
+        if (pools[i] == NULL)
+            fail("mem_pool_open", i);
+    }
+    double open_us = now_us() - start;
+    long rss_open = rss_kib();
+
+    alloc_pt *allocs = calloc(BENCH_NUM_POOLS, sizeof(alloc_pt));
+    if (allocs == NULL)
+        fail("calloc", 0);
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i) {
+        allocs[i] = mem_new_alloc(pools[i], BENCH_TOUCH_SIZE);
+        if (allocs[i] == NULL)
+            fail("mem_new_alloc", i);
+        memset(allocs[i]->mem, 0xab, BENCH_TOUCH_SIZE);
+    }
+    long rss_touch = rss_kib();
+
+    for (unsigned i = 0; i < BENCH_NUM_POOLS; ++i) {
+        mem_del_alloc(pools[i], allocs[i]);
+        mem_pool_close(pools[i]);
+    }
+    mem_free();
+    free(allocs);
+    free(pools);
+
+    report("mem_pool_open", round, open_us, rss_base, rss_open, rss_touch);
+}
+
+
+/* main */
+int main(void) {
+
+    printf("%u pools of %lu bytes, %lu bytes used in each\n\n",
+           BENCH_NUM_POOLS, (unsigned long) BENCH_POOL_SIZE, (unsigned long) BENCH_TOUCH_SIZE);
+    printf("%-14s %5s %14s %14s %14s\n",
+           "backing", "round", "open (us)", "RSS open (KiB)", "RSS used (KiB)");
+
+    for (unsigned round = 1; round <= BENCH_ROUNDS; ++round) {
+        bench_calloc(round);
+        bench_mem_pool(round);
+    }
+
+    return 0;
+}
@@ -7,8 +7,32 @@
  * OS,  Spring 2016
  */
 
+#define _DEFAULT_SOURCE // for MAP_ANONYMOUS
+
 #include <stdlib.h>
 #include <stdio.h> // for perror()
+#include <stdint.h> // for uintptr_t
+#include <string.h> // for memcpy()
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // for the SSE2 and AVX2 gap search
+#define MEM_X86_SIMD
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h> // for mmap()
+#include <unistd.h> // for sysconf()
+#define MEM_MMAP
+
+// pages given back read as zeros again on Linux; elsewhere they're only
+// marked free, and may keep their contents until reclaimed
+#if defined(__linux__) && defined(MADV_DONTNEED)
+#define MEM_MADV_RELEASE MADV_DONTNEED
+#define MEM_MADV_ZEROES
+#elif defined(MADV_FREE)
+#define MEM_MADV_RELEASE MADV_FREE
+#endif
+#endif
 
 #include "mem_pool.h"
 
@@ -25,13 +49,48 @@ static const unsigned   MEM_POOL_STORE_INIT_CAPACITY    = 20;
 static const float      MEM_POOL_STORE_FILL_FACTOR      = 0.75;
 static const unsigned   MEM_POOL_STORE_EXPAND_FACTOR    = 2;
 
-static const unsigned   MEM_NODE_HEAP_INIT_CAPACITY     = 40;
-static const float      MEM_NODE_HEAP_FILL_FACTOR       = 0.75;
-static const unsigned   MEM_NODE_HEAP_EXPAND_FACTOR     = 2;
+static const unsigned   MEM_NODE_HEAP_CHUNK_SIZE        = 64; // nodes per chunk
 
 static const unsigned   MEM_GAP_IX_INIT_CAPACITY        = 40;
 static const float      MEM_GAP_IX_FILL_FACTOR          = 0.75;
 static const unsigned   MEM_GAP_IX_EXPAND_FACTOR        = 2;
+static const unsigned   MEM_GAP_IX_NIL                  = (unsigned) -1;
+
+static const unsigned   MEM_ADDR_IX_INIT_CAPACITY       = 64; // power of 2
+static const float      MEM_ADDR_IX_FILL_FACTOR         = 0.5;
+static const unsigned   MEM_ADDR_IX_EXPAND_FACTOR       = 2;
+
+static const unsigned   MEM_GAP_BINS                    = 64; // one per bit of size_t
+
+static const unsigned   MEM_TLSF_SL_LOG                 = 4;
+static const unsigned   MEM_TLSF_SL_COUNT               = 16; // 1 << MEM_TLSF_SL_LOG
+static const unsigned   MEM_TLSF_FL_COUNT               = 61; // 64 - MEM_TLSF_SL_LOG + 1
+
+static const size_t     MEM_TAG_ALIGN                   = sizeof(size_t);
+static const size_t     MEM_TAG_OVERHEAD                = sizeof(alloc_t) + 2 * sizeof(size_t); // header, footer
+static const size_t     MEM_TAG_MIN_LENGTH              = sizeof(alloc_t) + 2 * sizeof(size_t) + 2 * sizeof(void *);
+
+static const unsigned   MEM_COMPACT_INIT_CAPACITY       = 64; // multiple of 64, for the bitmap
+static const unsigned   MEM_COMPACT_EXPAND_FACTOR       = 2;
+static const unsigned   MEM_COMPACT_NIL                 = (unsigned) -1;
+static const unsigned   MEM_RECORD_CHUNK_SIZE           = 64; // records per chunk
+
+static const size_t     MEM_BITMAP_GRANULE              = 64; // default granule size
+static const unsigned   MEM_BITMAP_MAX_LEVELS           = 6; // 64^6 granules
+static const size_t     MEM_BITMAP_NIL                  = (size_t) -1;
+
+static const unsigned   MEM_QUICK_LISTS                 = 128; // one per size, from 1 byte up
+static const unsigned   MEM_QUICK_LIST_DEPTH            = 16; // blocks per list before coalescing
+
+static const size_t     MEM_HUGE_PAGE_SIZE              = 2 << 20; // 2 MiB, as on x86-64 and arm64
+
+static const unsigned   MEM_ARENA_INIT_CAPACITY         = 4;
+static const unsigned   MEM_ARENA_EXPAND_FACTOR         = 2;
+
+static const size_t     MEM_RESERVE_DEFAULT             = 1 << 30; // 1 GiB, or 4 times the size if larger
+
+static const unsigned   MEM_ZERO_INIT_CAPACITY          = 16;
+static const unsigned   MEM_ZERO_EXPAND_FACTOR          = 2;
 
 
 
@@ -45,20 +104,142 @@ typedef struct _node {
     unsigned used;
     unsigned allocated;
     struct _node *next, *prev; // doubly-linked list for gap deletion
+    struct _node *next_gap, *prev_gap; // gap list of a bin (SEGREGATED_FIT, TLSF, BUDDY)
+    unsigned gap_slot; // entry in gap_ix while a gap (FIRST_FIT, BEST_FIT, NEXT_FIT)
+    unsigned arena_start; // POOL_GROWABLE: first node of an arena, never merged with the one before
 } node_t, *node_pt;
 
+// the node heap is a list of fixed-size chunks of nodes, which never move
+// once allocated, so node pointers (and the user's alloc_pt) stay valid
+typedef struct _node_chunk {
+    struct _node_chunk *next;
+    node_t nodes[]; // MEM_NODE_HEAP_CHUNK_SIZE of them
+} node_chunk_t, *node_chunk_pt;
+
+// the gap index is an AVL tree keyed by (size, node->alloc_record.mem),
+// or by address alone in a FIRST_FIT or NEXT_FIT pool, stored in the gap_ix array and
+// linked by slot numbers, so that the links survive a realloc() of the array
 typedef struct _gap {
     size_t size;
     node_pt node;
+    unsigned left, right, parent; // slots in gap_ix, MEM_GAP_IX_NIL if none
+    unsigned height;
+    size_t max_size; // largest gap in the subtree
 } gap_t, *gap_pt;
 
+// a boundary-tagged pool keeps its metadata in the pool memory itself:
+// every segment starts with a header and ends with a footer that holds a
+// copy of its length, the lowest bit of which is set for an allocation
+typedef struct _tag {
+    alloc_t alloc_record; // handed to the user; mem is NULL for a gap
+    size_t length; // of the whole segment, tags included
+} tag_t, *tag_pt;
+
+// the payload of a gap links it into the pool's gap list
+typedef struct _tag_gap {
+    tag_pt next_gap, prev_gap;
+} tag_gap_t, *tag_gap_pt;
+
+// a slab pool is cut into equal slots, each with a fixed record, and the
+// free ones are linked into the pool's free list
+typedef struct _slab_slot {
+    alloc_t alloc_record; // handed to the user; size is 0 while free
+    struct _slab_slot *next_free;
+} slab_slot_t, *slab_slot_pt;
+
+// the allocation records of a compact pool are kept in fixed-size chunks,
+// like the nodes of the node heap, so that they never move
+typedef struct _record_chunk {
+    struct _record_chunk *next;
+    alloc_t records[]; // MEM_RECORD_CHUNK_SIZE of them
+} record_chunk_t, *record_chunk_pt;
+
+// a gap search kernel finds the first gap of at least size (> 0) among the
+// compact segments from up to n
+typedef unsigned (*fit_kernel_t)(const uint32_t *sizes, const uint64_t *allocated,
+                                 unsigned from, unsigned n, uint32_t size);
+
+// a level of the bitmap of a BITMAP pool: at the bottom, a bit per
+// granule, set while it's free, and above, a bit per word of the level
+// below, set while that word isn't 0
+typedef struct _bitmap_level {
+    uint64_t *bits;
+    size_t num_words;
+} bitmap_level_t, *bitmap_level_pt;
+
+// a quick list holds freed blocks of one exact size, most recent first
+typedef struct _quick_list {
+    node_pt head; // linked through next_gap
+    unsigned count;
+} quick_list_t, *quick_list_pt;
+
+// an arena is one mapping of a growable pool, the first being pool.mem
+typedef struct _arena {
+    char *mem;
+    size_t size; // as counted in total_size
+    size_t mapped_size;
+    node_pt first; // the node at mem, never merged with the one before it
+} arena_t, *arena_pt;
+
+// a zero range is part of the gaps known to read as zeros: released by
+// a trim, or not used since it was mapped
+typedef struct _zero_range {
+    char *mem;
+    size_t size;
+} zero_range_t, *zero_range_pt;
+
 typedef struct _pool_mgr {
     pool_t pool;
-    node_pt node_heap;
+    unsigned flags; // POOL_* options the pool was opened with
+    size_t mapped_size; // length of the mapping of pool.mem, at least the size opened with
+    tag_pt tag_gaps; // POOL_BOUNDARY_TAGS: list of gaps
+    size_t slab_object_size; // SLAB: size of every slot
+    slab_slot_pt slab_slots; // SLAB: one record per slot
+    unsigned num_slab_slots;
+    slab_slot_pt slab_free; // SLAB: list of free slots, linked through next_free
+    uint32_t *compact_sizes; // POOL_COMPACT_NODES: segment sizes, in address order
+    uint64_t *compact_allocated; // POOL_COMPACT_NODES: bit set for each allocation
+    uint32_t *compact_offsets; // POOL_COMPACT_NODES: segment offsets in the pool
+    alloc_pt *compact_records; // POOL_COMPACT_NODES: record of each allocation
+    unsigned num_compact_segs;
+    unsigned compact_capacity;
+    record_chunk_pt record_heap; // POOL_COMPACT_NODES: chunks of records
+    alloc_pt unused_records; // stack of unused records, linked through mem
+    size_t bitmap_granule; // BITMAP: size of the granules
+    size_t num_granules;
+    bitmap_level_pt bitmap_levels; // BITMAP: free granules, bottom level first
+    unsigned num_bitmap_levels;
+    uint64_t *bitmap_starts; // BITMAP: bit set for the first granule of each allocation
+    node_chunk_pt node_heap; // the first chunk holds the top node
     unsigned total_nodes;
     unsigned used_nodes;
+    node_pt unused_nodes; // stack of unused nodes, linked through next
     gap_pt gap_ix;
+    unsigned gap_ix_size; // entries in gap_ix, which are num_gaps less the wilderness
     unsigned gap_ix_capacity;
+    unsigned gap_ix_root;
+    char *next_fit_cursor; // NEXT_FIT: end of the latest allocation
+    node_pt wilderness; // FIRST_FIT, BEST_FIT, NEXT_FIT: the gap at the end of the pool, kept out of gap_ix
+    node_pt last_node; // the node at the end of the list, in the highest arena
+    alloc_pt *addr_ix; // hash of allocation addresses to their records
+    unsigned addr_ix_capacity;
+    node_pt *gap_bins; // SEGREGATED_FIT, TLSF, BUDDY: gap lists by size class
+    unsigned num_gap_bins;
+    unsigned long long gap_bin_map; // bit set for each non-empty bin (TLSF: first level)
+    unsigned *gap_bin_sl_map; // TLSF: bit set for each non-empty second-level bin
+    quick_list_pt quick_lists; // POOL_QUICK_LISTS: freed blocks not yet coalesced, by size
+    unsigned num_quick; // blocks on all the quick lists
+    arena_pt arenas; // POOL_GROWABLE: all the mappings, in address order
+    unsigned num_arenas;
+    unsigned arena_capacity;
+    size_t arena_size; // POOL_GROWABLE: the size opened with, the least an arena adds
+    size_t committed_size; // POOL_RESERVE: bytes of the reservation (mapped_size) made accessible
+    zero_range_pt zero_ranges; // node heap: gap memory known to be zero, in address order
+    unsigned num_zero_ranges;
+    unsigned zero_capacity;
+    unsigned zero_tracking; // set once the zero ranges are kept up to date
+    unsigned zero_pending; // set by mem_new_alloc_zeroed until the allocation is zeroed
+    size_t trim_threshold; // gaps of at least this size are released as they form, 0 for never
 } pool_mgr_t, *pool_mgr_pt;
 
 
@@ -71,6 +252,7 @@ typedef struct _pool_mgr {
 static pool_mgr_pt *pool_store = NULL; // an array of pointers, only expand
 static unsigned pool_store_size = 0;
 static unsigned pool_store_capacity = 0;
+static fit_kernel_t fit_kernel = NULL; // the best one the CPU supports
 
 
 
@@ -80,11 +262,104 @@ static unsigned pool_store_capacity = 0;
 /*                                          */
 /********************************************/
 static alloc_status _mem_resize_pool_store();
+static char *_mem_map(size_t size, int huge, pool_backing *backing, size_t *mapped_size);
+static void _mem_unmap(char *mem, size_t mapped_size);
+static node_pt _mem_add_arena(pool_mgr_pt pool_mgr, size_t size);
+static node_pt _mem_first_node(pool_mgr_pt pool_mgr);
+static void _mem_remove_arena(pool_mgr_pt pool_mgr, unsigned a);
+static char *_mem_reserve(size_t reserve_size, size_t size, size_t *committed_size);
+static node_pt _mem_commit_reserve(pool_mgr_pt pool_mgr, size_t size);
+static size_t _mem_page_size();
+static void _mem_release_gap(pool_mgr_pt pool_mgr, node_pt node);
+static unsigned _mem_find_zero_range(pool_mgr_pt pool_mgr, const char *mem);
+static void _mem_add_zero_range(pool_mgr_pt pool_mgr, char *mem, size_t size);
+static void _mem_take_zero_ranges(pool_mgr_pt pool_mgr, char *mem, size_t size);
+static void _mem_free_pool_mgr(pool_mgr_pt pool_mgr);
 static alloc_status _mem_resize_node_heap(pool_mgr_pt pool_mgr);
 static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr);
+static alloc_status _mem_resize_addr_ix(pool_mgr_pt pool_mgr);
+static node_pt _mem_find_gap(pool_mgr_pt pool_mgr, size_t size);
+static alloc_pt _mem_alloc_from_gap(pool_mgr_pt pool_mgr, node_pt node_alloc, size_t size);
+static node_pt _mem_find_aligned_gap(pool_mgr_pt pool_mgr, size_t size, size_t alignment);
+static size_t _mem_align_padding(const char *mem, size_t alignment);
+static int _mem_is_live_alloc(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_status _mem_grow_alloc(pool_mgr_pt pool_mgr, node_pt node, size_t size);
+static alloc_status _mem_shrink_alloc(pool_mgr_pt pool_mgr, node_pt node, size_t size);
+static alloc_status _mem_add_gap(pool_mgr_pt pool_mgr, size_t size, node_pt node);
+static alloc_status _mem_remove_gap(pool_mgr_pt pool_mgr, size_t size, node_pt node);
 static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node);
-static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node);
-static alloc_status _mem_sort_gap_ix(pool_mgr_pt pool_mgr);
+static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr, node_pt node);
+static node_pt _mem_find_best_gap(pool_mgr_pt pool_mgr, size_t size);
+static node_pt _mem_find_first_gap(pool_mgr_pt pool_mgr, size_t size);
+static node_pt _mem_find_next_gap(pool_mgr_pt pool_mgr, unsigned slot, size_t size, const char *cursor);
+static node_pt _mem_fit_wilderness(pool_mgr_pt pool_mgr, size_t size);
+static void _mem_add_to_gap_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node);
+static void _mem_remove_from_gap_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node);
+static node_pt _mem_find_binned_gap(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_tlsf_bin(size_t size);
+static void _mem_add_to_tlsf_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node);
+static void _mem_remove_from_tlsf_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node);
+static node_pt _mem_find_tlsf_gap(pool_mgr_pt pool_mgr, size_t size);
+static size_t _mem_buddy_size(size_t size);
+static alloc_status _mem_init_buddy_blocks(pool_mgr_pt pool_mgr);
+static node_pt _mem_split_buddy(pool_mgr_pt pool_mgr, node_pt node, size_t size);
+static void _mem_merge_buddy(pool_mgr_pt pool_mgr, node_pt node);
+static unsigned _mem_log2(size_t size);
+static unsigned _mem_lowest_bit(unsigned long long map);
+static void _mem_link_gap(node_pt *list, node_pt node);
+static void _mem_unlink_gap(node_pt *list, node_pt node);
+static void _mem_push_unused_node(pool_mgr_pt pool_mgr, node_pt node);
+static node_pt _mem_pop_unused_node(pool_mgr_pt pool_mgr);
+static unsigned _mem_addr_ix_hash(pool_mgr_pt pool_mgr, const char *mem);
+static void _mem_add_to_addr_ix(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static void _mem_remove_from_addr_ix(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_pt _mem_find_in_addr_ix(pool_mgr_pt pool_mgr, const char *mem);
+static int _mem_gap_ix_less(pool_mgr_pt pool_mgr, size_t size, const char *mem, const gap_t *gap);
+static unsigned _mem_gap_ix_height(pool_mgr_pt pool_mgr, unsigned slot);
+static void _mem_update_gap_ix(pool_mgr_pt pool_mgr, unsigned slot);
+static int _mem_check_gap_ix(pool_mgr_pt pool_mgr, unsigned slot, unsigned parent,
+                             unsigned *prev, unsigned *count);
+static void _mem_relink_gap_ix(pool_mgr_pt pool_mgr, unsigned parent, unsigned old, unsigned new);
+static unsigned _mem_rotate_gap_ix(pool_mgr_pt pool_mgr, unsigned slot, int left);
+static void _mem_rebalance_gap_ix(pool_mgr_pt pool_mgr, unsigned slot);
+static void _mem_init_tags(pool_mgr_pt pool_mgr);
+static void _mem_set_tags(tag_pt tag, size_t length, size_t size, char *mem);
+static tag_gap_pt _mem_tag_gap_links(tag_pt tag);
+static void _mem_link_tag_gap(pool_mgr_pt pool_mgr, tag_pt tag);
+static void _mem_unlink_tag_gap(pool_mgr_pt pool_mgr, tag_pt tag);
+static alloc_pt _mem_new_tagged_alloc(pool_mgr_pt pool_mgr, size_t size);
+static tag_pt _mem_find_tag(pool_mgr_pt pool_mgr, const char *mem);
+static void _mem_del_tagged_alloc(pool_mgr_pt pool_mgr, tag_pt tag);
+static void _mem_init_slab_slots(pool_mgr_pt pool_mgr);
+static alloc_pt _mem_new_slab_alloc(pool_mgr_pt pool_mgr, size_t size);
+static slab_slot_pt _mem_find_slab_slot(pool_mgr_pt pool_mgr, const char *mem);
+static void _mem_del_slab_alloc(pool_mgr_pt pool_mgr, slab_slot_pt slot);
+static alloc_status _mem_resize_compact_segs(pool_mgr_pt pool_mgr);
+static alloc_status _mem_resize_record_heap(pool_mgr_pt pool_mgr);
+static void _mem_insert_compact_seg(pool_mgr_pt pool_mgr, unsigned pos);
+static void _mem_remove_compact_seg(pool_mgr_pt pool_mgr, unsigned pos);
+static alloc_pt _mem_new_compact_alloc(pool_mgr_pt pool_mgr, size_t size);
+static unsigned _mem_find_compact_seg(pool_mgr_pt pool_mgr, const char *mem);
+static void _mem_del_compact_alloc(pool_mgr_pt pool_mgr, unsigned pos);
+static alloc_status _mem_init_bitmap(pool_mgr_pt pool_mgr);
+static void _mem_set_granules(pool_mgr_pt pool_mgr, size_t start, size_t count, int free);
+static size_t _mem_next_free_granule(pool_mgr_pt pool_mgr, size_t from);
+static size_t _mem_next_bit(const uint64_t *bits, size_t from, size_t limit, int set);
+static alloc_pt _mem_new_bitmap_alloc(pool_mgr_pt pool_mgr, size_t size);
+static void _mem_del_bitmap_alloc(pool_mgr_pt pool_mgr, alloc_pt alloc);
+static alloc_status _mem_coalesce_gap(pool_mgr_pt pool_mgr, node_pt node);
+static alloc_status _mem_add_to_quick_list(pool_mgr_pt pool_mgr, node_pt node);
+static alloc_pt _mem_new_quick_alloc(pool_mgr_pt pool_mgr, size_t size);
+static void _mem_flush_quick_lists(pool_mgr_pt pool_mgr);
+static fit_kernel_t _mem_select_fit_kernel();
+static unsigned _mem_find_fit_scalar(const uint32_t *sizes, const uint64_t *allocated,
+                                     unsigned from, unsigned n, uint32_t size);
+#ifdef MEM_X86_SIMD
+static unsigned _mem_find_fit_sse2(const uint32_t *sizes, const uint64_t *allocated,
+                                   unsigned from, unsigned n, uint32_t size);
+static unsigned _mem_find_fit_avx2(const uint32_t *sizes, const uint64_t *allocated,
+                                   unsigned from, unsigned n, uint32_t size);
+#endif
 
 
 
@@ -103,6 +378,9 @@ alloc_status mem_init() {
         pool_store = calloc(MEM_POOL_STORE_INIT_CAPACITY, sizeof(pool_mgr_pt));
         pool_store_capacity = MEM_POOL_STORE_INIT_CAPACITY;
         pool_store_size = 0;
+
+        // pick the gap search kernel for this CPU
+        fit_kernel = _mem_select_fit_kernel();
         return ALLOC_OK;
     }
 
@@ -138,10 +416,82 @@ alloc_status mem_free() {
 
 pool_pt mem_pool_open(size_t size, alloc_policy policy) {
 
+    // open with the default options
+    return mem_pool_open_ex(size, policy, NULL);
+}
+
+
+pool_pt mem_pool_open_ex(size_t size, alloc_policy policy, const pool_options_t *options) {
+
     // make sure there the pool store is allocated
     if (pool_store == NULL)
         return NULL;
 
+    // make sure the policy is one we know
+    if (policy != FIRST_FIT && policy != BEST_FIT &&
+        policy != SEGREGATED_FIT && policy != TLSF && policy != BUDDY &&
+        policy != SLAB && policy != NEXT_FIT && policy != BITMAP)
+        return NULL;
+
+    // make sure the options are ones we know
+    unsigned flags = (options == NULL) ? 0 : options->flags;
+    if (flags & ~(POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES | POOL_QUICK_LISTS | POOL_HUGE_PAGES |
+                  POOL_GROWABLE | POOL_RESERVE))
+        return NULL;
+
+    // quick lists hold nodes, and a buddy block only merges with its buddy
+    if ((flags & POOL_QUICK_LISTS) &&
+        (policy == BUDDY || policy == SLAB || policy == BITMAP ||
+         (flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES))))
+        return NULL;
+
+    // a growable pool links its arenas into the node list, and a buddy
+    // pool can't take a block of any size
+    if ((flags & POOL_GROWABLE) &&
+        (policy == BUDDY || policy == SLAB || policy == BITMAP ||
+         (flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES))))
+        return NULL;
+
+    // a reserving pool grows the gap at the end of its node list, which a
+    // buddy pool doesn't have, and the reservation has to hold the pool
+    // (by default, the larger of MEM_RESERVE_DEFAULT and 4 times the size)
+    size_t reserve_size = (options == NULL) ? 0 : options->reserve_size;
+    if (reserve_size == 0)
+        reserve_size = (size > MEM_RESERVE_DEFAULT / 4) ?
+                       ((size > (size_t) -1 / 4) ? size : 4 * size) : MEM_RESERVE_DEFAULT;
+    if ((flags & POOL_RESERVE) &&
+        (policy == BUDDY || policy == SLAB || policy == BITMAP || reserve_size < size ||
+         (flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES | POOL_GROWABLE | POOL_HUGE_PAGES))))
+        return NULL;
+
+    // a boundary-tagged pool searches its gap list by address or size,
+    // and is cut into whole tag-aligned segments
+    if ((flags & POOL_BOUNDARY_TAGS) &&
+        ((policy != FIRST_FIT && policy != BEST_FIT) ||
+         size % MEM_TAG_ALIGN != 0 || size < MEM_TAG_MIN_LENGTH))
+        return NULL;
+
+    // a compact pool scans its segments by address or size, and has to fit
+    // its offsets and sizes in 32 bits
+    if ((flags & POOL_COMPACT_NODES) &&
+        ((policy != FIRST_FIT && policy != BEST_FIT) ||
+         (flags & POOL_BOUNDARY_TAGS) || size > UINT32_MAX))
+        return NULL;
+
+    // a slab pool has room for at least one object, and counts its slots
+    // in an unsigned
+    size_t object_size = (options == NULL) ? 0 : options->object_size;
+    if (policy == SLAB &&
+        (object_size == 0 || size / object_size == 0 ||
+         size / object_size > (unsigned) -1))
+        return NULL;
+
+    // a bitmap pool is cut into whole granules
+    size_t granule_size = (options == NULL || options->granule_size == 0) ?
+                          MEM_BITMAP_GRANULE : options->granule_size;
+    if (policy == BITMAP && (size == 0 || size % granule_size != 0))
+        return NULL;
+
     // expand the pool store, if necessary
     _mem_resize_pool_store();
 
@@ -155,51 +505,144 @@ pool_pt mem_pool_open(size_t size, alloc_policy policy) {
 
 
     // allocate a new memory pool
-    pool_mgr->pool.mem = (char*) calloc(size, sizeof(char));
+    // (or reserve the range for one, committing the size)
+    if (flags & POOL_RESERVE) {
+        pool_mgr->pool.mem = _mem_reserve(reserve_size, size, &pool_mgr->committed_size);
+        pool_mgr->pool.backing = BACKING_PAGES;
+        pool_mgr->mapped_size = reserve_size;
+    }
+    else {
+        pool_mgr->pool.mem = _mem_map(size, flags & POOL_HUGE_PAGES,
+                                      &pool_mgr->pool.backing, &pool_mgr->mapped_size);
+    }
     pool_mgr->pool.policy = policy;
     pool_mgr->pool.total_size = size;
     pool_mgr->pool.alloc_size = 0;
     pool_mgr->pool.num_allocs = 0;
-    pool_mgr->pool.num_gaps = 1;
+    pool_mgr->pool.num_gaps = 0;
+    pool_mgr->flags = flags;
+
+    // a boundary-tagged pool needs nothing else: it starts out as one
+    // gap, tagged in place
+    if (flags & POOL_BOUNDARY_TAGS) {
+        if (pool_mgr->pool.mem == NULL) {
+            _mem_free_pool_mgr(pool_mgr);
+            return NULL;
+        }
 
-    // check success, on error deallocate mgr and return null
-    if((&pool_mgr->pool) == NULL){
-        free(pool_mgr);
-        return NULL;
+        _mem_init_tags(pool_mgr);
+
+        pool_store[pool_store_size] = pool_mgr;
+        pool_store_size++;
+
+        return (pool_pt) pool_mgr;
     }
 
-    // allocate a new node heap
-    pool_mgr->node_heap = calloc(MEM_NODE_HEAP_INIT_CAPACITY, sizeof(node_t));
+    // a compact pool needs no nodes either, but its segment arrays, which
+    // start out with the whole pool as one gap
+    if (flags & POOL_COMPACT_NODES) {
+        if (pool_mgr->pool.mem == NULL ||
+            _mem_resize_compact_segs(pool_mgr) == ALLOC_FAIL) {
+            _mem_free_pool_mgr(pool_mgr);
+            return NULL;
+        }
 
+        pool_mgr->compact_sizes[0] = (uint32_t) size;
+        pool_mgr->compact_offsets[0] = 0;
+        pool_mgr->num_compact_segs = 1;
+        pool_mgr->pool.num_gaps = 1;
 
-    // check success, on error deallocate mgr/pool and return null
-    if(pool_mgr->node_heap == NULL){
+        pool_store[pool_store_size] = pool_mgr;
+        pool_store_size++;
 
-        free(pool_mgr);
-        free(&pool_mgr->pool);
-        return NULL;
+        return (pool_pt) pool_mgr;
+    }
+
+    // a bitmap pool needs no nodes either, but its bitmap, all free, and
+    // an address index for its records
+    if (policy == BITMAP) {
+        pool_mgr->bitmap_granule = granule_size;
+        pool_mgr->num_granules = size / granule_size;
+        pool_mgr->addr_ix = calloc(MEM_ADDR_IX_INIT_CAPACITY, sizeof(alloc_pt));
+        pool_mgr->addr_ix_capacity = MEM_ADDR_IX_INIT_CAPACITY;
+        if (pool_mgr->pool.mem == NULL || pool_mgr->addr_ix == NULL ||
+            _mem_init_bitmap(pool_mgr) == ALLOC_FAIL) {
+            _mem_free_pool_mgr(pool_mgr);
+            return NULL;
+        }
 
+        pool_store[pool_store_size] = pool_mgr;
+        pool_store_size++;
+
+        return (pool_pt) pool_mgr;
     }
 
-    // allocate a new gap index
-    pool_mgr->gap_ix = calloc(MEM_GAP_IX_INIT_CAPACITY, sizeof(gap_t));
+    // a slab pool needs no nodes either, just a record for each slot
+    if (policy == SLAB) {
+        pool_mgr->slab_object_size = object_size;
+        pool_mgr->num_slab_slots = (unsigned) (size / object_size);
+        pool_mgr->slab_slots = calloc(pool_mgr->num_slab_slots, sizeof(slab_slot_t));
+        if (pool_mgr->pool.mem == NULL || pool_mgr->slab_slots == NULL) {
+            _mem_free_pool_mgr(pool_mgr);
+            return NULL;
+        }
+
+        _mem_init_slab_slots(pool_mgr);
 
+        pool_store[pool_store_size] = pool_mgr;
+        pool_store_size++;
 
+        return (pool_pt) pool_mgr;
+    }
 
-    // check success, on error deallocate mgr/pool/heap and return null
-    if(pool_mgr->gap_ix == NULL){
+    // allocate a new node heap
+    // allocate a new address index
+    pool_mgr->node_heap = calloc(1, sizeof(node_chunk_t) + MEM_NODE_HEAP_CHUNK_SIZE * sizeof(node_t));
+    pool_mgr->addr_ix = calloc(MEM_ADDR_IX_INIT_CAPACITY, sizeof(alloc_pt));
+
+    // allocate a new gap index or size-class bins, if the policy uses them
+    if (policy == FIRST_FIT || policy == BEST_FIT || policy == NEXT_FIT)
+        pool_mgr->gap_ix = calloc(MEM_GAP_IX_INIT_CAPACITY, sizeof(gap_t));
+    if (policy == SEGREGATED_FIT || policy == BUDDY) {
+        pool_mgr->num_gap_bins = MEM_GAP_BINS;
+        pool_mgr->gap_bins = calloc(pool_mgr->num_gap_bins, sizeof(node_pt));
+    }
+    if (policy == TLSF) {
+        pool_mgr->num_gap_bins = MEM_TLSF_FL_COUNT * MEM_TLSF_SL_COUNT;
+        pool_mgr->gap_bins = calloc(pool_mgr->num_gap_bins, sizeof(node_pt));
+        pool_mgr->gap_bin_sl_map = calloc(MEM_TLSF_FL_COUNT, sizeof(unsigned));
+    }
 
-        free(pool_mgr);
-        free(&pool_mgr->pool);
-        free(pool_mgr->node_heap);
+    // allocate the quick lists, if asked for
+    if (flags & POOL_QUICK_LISTS)
+        pool_mgr->quick_lists = calloc(MEM_QUICK_LISTS, sizeof(quick_list_t));
+
+    // allocate the arena array, if growable
+    if (flags & POOL_GROWABLE)
+        pool_mgr->arenas = calloc(MEM_ARENA_INIT_CAPACITY, sizeof(arena_t));
+
+    // allocate the zero ranges
+    pool_mgr->zero_ranges = calloc(MEM_ZERO_INIT_CAPACITY, sizeof(zero_range_t));
+
+    // check success, on error deallocate whatever was allocated and return null
+    if (pool_mgr->pool.mem == NULL ||
+        pool_mgr->node_heap == NULL ||
+        pool_mgr->addr_ix == NULL ||
+        ((policy == FIRST_FIT || policy == BEST_FIT || policy == NEXT_FIT) && pool_mgr->gap_ix == NULL) ||
+        ((policy == SEGREGATED_FIT || policy == BUDDY) && pool_mgr->gap_bins == NULL) ||
+        (policy == TLSF && (pool_mgr->gap_bins == NULL || pool_mgr->gap_bin_sl_map == NULL)) ||
+        ((flags & POOL_QUICK_LISTS) && pool_mgr->quick_lists == NULL) ||
+        ((flags & POOL_GROWABLE) && pool_mgr->arenas == NULL) ||
+        pool_mgr->zero_ranges == NULL) {
+
+        _mem_free_pool_mgr(pool_mgr);
         return NULL;
-
     }
 
 
     // assign all the pointers and update meta data:
     //   initialize top node of node heap
-    node_pt node_h = (node_pt) pool_mgr->node_heap;
+    node_pt node_h = pool_mgr->node_heap->nodes;
 
     node_h->alloc_record.size = size;
     node_h->alloc_record.mem = pool_mgr->pool.mem;
@@ -207,16 +650,55 @@ pool_pt mem_pool_open(size_t size, alloc_policy policy) {
     node_h->allocated = 0;
     node_h->next = NULL;
     node_h->prev = NULL;
+    node_h->next_gap = NULL;
+    node_h->prev_gap = NULL;
 
-
-
-    //   initialize top node of gap index
     //   initialize pool mgr
-    pool_mgr->gap_ix[0].size = size;
-    pool_mgr->gap_ix[0].node = pool_mgr->node_heap;
+    pool_mgr->gap_ix_root = MEM_GAP_IX_NIL;
+    pool_mgr->gap_ix_size = 0;
+    pool_mgr->wilderness = NULL;
+    pool_mgr->last_node = node_h;
     pool_mgr->gap_ix_capacity = MEM_GAP_IX_INIT_CAPACITY;
-    pool_mgr->total_nodes = MEM_NODE_HEAP_INIT_CAPACITY;
+    pool_mgr->next_fit_cursor = pool_mgr->pool.mem;
+    pool_mgr->gap_bin_map = 0;
+    pool_mgr->addr_ix_capacity = MEM_ADDR_IX_INIT_CAPACITY;
+    pool_mgr->total_nodes = MEM_NODE_HEAP_CHUNK_SIZE;
     pool_mgr->used_nodes = 1;
+    pool_mgr->zero_capacity = MEM_ZERO_INIT_CAPACITY;
+    pool_mgr->trim_threshold = (options == NULL) ? 0 : options->trim_threshold;
+    pool_mgr->zero_tracking = (pool_mgr->trim_threshold > 0);
+
+    //   the memory is all zeros, as mapped
+    _mem_add_zero_range(pool_mgr, pool_mgr->pool.mem, size);
+
+    //   the pool memory is the first arena, if growable
+    if (flags & POOL_GROWABLE) {
+        pool_mgr->arenas[0].mem = pool_mgr->pool.mem;
+        pool_mgr->arenas[0].size = size;
+        pool_mgr->arenas[0].mapped_size = pool_mgr->mapped_size;
+        pool_mgr->arenas[0].first = node_h;
+        node_h->arena_start = 1;
+        pool_mgr->num_arenas = 1;
+        pool_mgr->arena_capacity = MEM_ARENA_INIT_CAPACITY;
+        pool_mgr->arena_size = size;
+    }
+
+    //   stack up the rest of the node heap as unused
+    pool_mgr->unused_nodes = NULL;
+    unsigned i = pool_mgr->total_nodes;
+    while (--i > 0)
+        _mem_push_unused_node(pool_mgr, &node_h[i]);
+
+    //   the top node is the only gap
+    //   (a buddy pool cuts it into power-of-2 blocks)
+    if (policy == BUDDY && size > 0) {
+        if (_mem_init_buddy_blocks(pool_mgr) == ALLOC_FAIL) {
+            _mem_free_pool_mgr(pool_mgr);
+            return NULL;
+        }
+    }
+    else
+        _mem_add_gap(pool_mgr, size, node_h);
 
     //   link pool mgr to pool store
     pool_store[pool_store_size] = pool_mgr;
@@ -233,17 +715,14 @@ alloc_status mem_pool_close(pool_pt pool) {
     // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
+    // coalesce whatever is still on the quick lists
+    if (pool != NULL && pool_mgr->num_quick > 0)
+        _mem_flush_quick_lists(pool_mgr);
+
     // check if this pool is allocated
     if (pool == NULL  || !pool->num_gaps == 1 || !pool->num_allocs == 0)
         return ALLOC_NOT_FREED;
 
-    // free memory pool
-    // free node heap
-    // free gap index
-    free(pool->mem);
-    free(pool_mgr->node_heap);
-    free(pool_mgr->gap_ix);
-
     int j = 0;
     while(j < pool_store_capacity) {
         if (pool_store[j] == pool_mgr) {
@@ -254,8 +733,8 @@ alloc_status mem_pool_close(pool_pt pool) {
     }
 
     // note: don't decrement pool_store_size, because it only grows
-    // free mgr
-    free(pool_mgr);
+    // free memory pool, node heap, indexes and mgr
+    _mem_free_pool_mgr(pool_mgr);
     return ALLOC_OK;
 }
 
@@ -266,252 +745,578 @@ alloc_pt mem_new_alloc(pool_pt pool, size_t size) {
     // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
-    // check if any gaps, return null if none
-    if (pool->num_gaps == 0)
+    // check if any gaps (or blocks on the quick lists), return null if none
+    // (empty allocations are refused, they would share their address, and
+    // a growable or reserving pool can always try to grow)
+    if ((pool->num_gaps == 0 && pool_mgr->num_quick == 0 &&
+         !(pool_mgr->flags & (POOL_GROWABLE | POOL_RESERVE))) ||
+        size == 0)
         return NULL;
 
+    // a boundary-tagged pool allocates in place
+    if (pool_mgr->flags & POOL_BOUNDARY_TAGS)
+        return _mem_new_tagged_alloc(pool_mgr, size);
+
+    // a compact pool scans its segment arrays
+    if (pool_mgr->flags & POOL_COMPACT_NODES)
+        return _mem_new_compact_alloc(pool_mgr, size);
+
+    // a bitmap pool looks for a run of free granules
+    if (pool->policy == BITMAP)
+        return _mem_new_bitmap_alloc(pool_mgr, size);
+
+    // a slab pool takes the first free slot off its list
+    if (pool->policy == SLAB)
+        return _mem_new_slab_alloc(pool_mgr, size);
+
     // expand heap node, if necessary, quit on error
-    _mem_resize_node_heap(pool_mgr);
+    if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+
+    // expand address index, if necessary, quit on error
+    if (_mem_resize_addr_ix(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+
+    // a freed block of just this size is reused as it is
+    if (pool_mgr->num_quick > 0 && size <= MEM_QUICK_LISTS &&
+        pool_mgr->quick_lists[size - 1].head != NULL)
+        return _mem_new_quick_alloc(pool_mgr, size);
+
+    // expand gap index, if necessary, quit on error
+    // (before anything changes, so that adding the remaining gap can't fail)
+    if ((pool->policy == FIRST_FIT || pool->policy == BEST_FIT || pool->policy == NEXT_FIT) &&
+        _mem_resize_gap_ix(pool_mgr) == ALLOC_FAIL)
+        return NULL;
 
     // check used nodes fewer than total nodes, quit on error
     if (pool_mgr->used_nodes >= pool_mgr->total_nodes)
         return NULL;
 
 
-    // get a node for allocation:
-    node_pt node_alloc = NULL;
+    // get a node for allocation, from whatever the policy of the pool
+    // searches
+    // (if BUDDY, then the size is rounded up to a power of 2 first, and
+    // the bins hold one block size each)
+    if (pool->policy == BUDDY)
+        size = _mem_buddy_size(size);
+    node_pt node_alloc = (size == 0) ? NULL : _mem_find_gap(pool_mgr, size);
 
-    // if FIRST_FIT, then find the first sufficient node in the node heap
-    if (pool->policy == FIRST_FIT) {
-        int i = 0;
-        while (i < pool_mgr->total_nodes) {
-            if (pool_mgr->node_heap[i].used == 1 &&
-                pool_mgr->node_heap[i].allocated == 0 &&
-                pool_mgr->node_heap[i].alloc_record.size >= size) {
-                node_alloc = &pool_mgr->node_heap[i];
-                break;
-            }
-            i++;
-        }
+    // check if node found
+    // (if not, coalescing the quick lists may make room, and else a
+    // growable pool allocates from the gap of a new arena, and a reserving
+    // pool from the gap at its end, grown into the reservation)
+    if (node_alloc == NULL && pool_mgr->num_quick > 0) {
+        _mem_flush_quick_lists(pool_mgr);
+        return mem_new_alloc(pool, size);
     }
+    if (node_alloc == NULL && (pool_mgr->flags & POOL_GROWABLE) && size > 0)
+        node_alloc = _mem_add_arena(pool_mgr, size);
+    if (node_alloc == NULL && (pool_mgr->flags & POOL_RESERVE) && size > 0)
+        node_alloc = _mem_commit_reserve(pool_mgr, size);
+    if (node_alloc == NULL)
+        return NULL;
 
-    else if (pool->policy == BEST_FIT) {
-        int i = 0;
-        while (i < pool_mgr->gap_ix_capacity) {
-            if (pool_mgr->gap_ix[i].size >= size) {
-                node_alloc = pool_mgr->gap_ix[i].node;
-                break;
-            }
-            i++;
-        }
+    // a buddy block is halved down to the size first, the upper halves
+    // becoming gaps, so that it leaves no remaining gap of its own
+    if (pool->policy == BUDDY) {
+        node_alloc = _mem_split_buddy(pool_mgr, node_alloc, size);
+        if (node_alloc == NULL)
+            return NULL;
     }
 
-    // check if node found
-    if (node_alloc == NULL)
-        return NULL;
 
+    // carve the allocation out of the start of the gap
+    return _mem_alloc_from_gap(pool_mgr, node_alloc, size);
+}
 
-    // update metadata (num_allocs, alloc_size)
-    // calculate the size of the remaining gap, if any
-    // remove node from gap index
-    pool->num_allocs += 1;
-    pool->alloc_size += size;
-    size_t remaining_gap = node_alloc->alloc_record.size - size;
-    _mem_remove_from_gap_ix(pool_mgr, size, node_alloc);
 
+alloc_status mem_del_alloc(pool_pt pool, alloc_pt alloc) {
 
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
+    // get node from alloc by casting the pointer to (node_pt)
+    node_pt node = (node_pt) alloc;
 
-    // convert gap_node to an allocation node of given size
-    node_alloc->alloc_record.size = size;
-    node_alloc->used = 1;
-    node_alloc->allocated = 1;
+    // in a boundary-tagged pool, the allocation record is the header of
+    // the segment, found right in front of its memory
+    if (pool_mgr->flags & POOL_BOUNDARY_TAGS) {
+        if (alloc == NULL || _mem_find_tag(pool_mgr, alloc->mem) != (tag_pt) alloc)
+            return ALLOC_FAIL;
 
+        _mem_del_tagged_alloc(pool_mgr, (tag_pt) alloc);
+        return ALLOC_OK;
+    }
 
-    // adjust node heap:
-    if (remaining_gap > 0) {
+    // in a compact pool, the allocation record is the one kept for the
+    // segment at its memory
+    if (pool_mgr->flags & POOL_COMPACT_NODES) {
+        unsigned pos = (alloc == NULL) ? MEM_COMPACT_NIL : _mem_find_compact_seg(pool_mgr, alloc->mem);
+        if (pos == MEM_COMPACT_NIL || pool_mgr->compact_records[pos] != alloc)
+            return ALLOC_FAIL;
 
-        //   if remaining gap, need a new node
-        node_pt nodes_unused = NULL;
+        _mem_del_compact_alloc(pool_mgr, pos);
+        return ALLOC_OK;
+    }
 
-        //   find an unused one in the node heap
-        int i = 0;
-        while(i < pool_mgr->total_nodes) {
-            if (pool_mgr->node_heap[i].used == 0) {
-                nodes_unused = &pool_mgr->node_heap[i];
-                break;
-            }
-            i++;
-        }
+    // in a bitmap pool, the allocation record is the one its address
+    // leads to
+    if (pool->policy == BITMAP) {
+        if (alloc == NULL || _mem_find_in_addr_ix(pool_mgr, alloc->mem) != alloc)
+            return ALLOC_FAIL;
 
-        //   make sure one was found
-        if (nodes_unused == NULL)
-            return NULL;
+        _mem_del_bitmap_alloc(pool_mgr, alloc);
+        return ALLOC_OK;
+    }
 
-        //   initialize it to a gap node
-        nodes_unused->alloc_record.mem = node_alloc->alloc_record.mem + size;
-        nodes_unused->alloc_record.size = remaining_gap;
-        nodes_unused->used = 1;
-        nodes_unused->allocated = 0;
-        nodes_unused->next = NULL;
-        nodes_unused->prev = NULL;
+    // in a slab pool, the allocation record is the slot's, found by the
+    // slot's memory
+    if (pool->policy == SLAB) {
+        if (alloc == NULL || _mem_find_slab_slot(pool_mgr, alloc->mem) != (slab_slot_pt) alloc)
+            return ALLOC_FAIL;
 
+        _mem_del_slab_alloc(pool_mgr, (slab_slot_pt) alloc);
+        return ALLOC_OK;
+    }
 
-        //   update metadata (used_nodes)
-        //   update linked list (new node right after the node for allocation)
-        pool_mgr->used_nodes++;
-        nodes_unused->prev = node_alloc;
-        nodes_unused->next = node_alloc->next;
-        if (node_alloc->next != NULL)
-            node_alloc->next->prev = nodes_unused;
-        node_alloc->next = nodes_unused;
+    // make sure it's a live allocation of this pool
+    // (nodes never move or go away while the pool is open, so the node
+    // can be read, and it's live iff its address leads back to it)
+    if (node == NULL || node->used == 0 || node->allocated == 0 ||
+        _mem_find_in_addr_ix(pool_mgr, node->alloc_record.mem) != alloc) {
+        return ALLOC_FAIL;
+    }
 
-        //   add to gap index
-        //   check if successful
-        if (_mem_add_to_gap_ix(pool_mgr, remaining_gap, nodes_unused) == ALLOC_FAIL)
-            return NULL;
+    // it's no longer findable by its address
+    _mem_remove_from_addr_ix(pool_mgr, alloc);
 
+    // update metadata (num_allocs, alloc_size)
+    pool->num_allocs--;
+    pool->alloc_size -= alloc->size;
+
+    // a small block waits on the quick list of its size for the next
+    // allocation of that size, unless the list is full, and then all the
+    // lists are coalesced along with it
+    if ((pool_mgr->flags & POOL_QUICK_LISTS) && alloc->size <= MEM_QUICK_LISTS) {
+        if (_mem_add_to_quick_list(pool_mgr, node) == ALLOC_OK)
+            return ALLOC_OK;
+
+        _mem_flush_quick_lists(pool_mgr);
     }
 
-    // return allocation record by casting the node to (alloc_pt)
-    return (alloc_pt) node_alloc;
+    // convert to gap node, merging it with the gaps around it
+    return _mem_coalesce_gap(pool_mgr, node);
 }
 
 
-alloc_status mem_del_alloc(pool_pt pool, alloc_pt alloc) {
+char *mem_new_alloc_addr(pool_pt pool, size_t size) {
+
+    // allocate as usual, but hand out the address in the pool, which
+    // (unlike the allocation record) never moves
+    alloc_pt alloc = mem_new_alloc(pool, size);
+
+    return (alloc == NULL) ? NULL : alloc->mem;
+}
+
+
+alloc_status mem_del_alloc_addr(pool_pt pool, char *mem) {
 
     // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
-    // get node from alloc by casting the pointer to (node_pt)
-    node_pt node = (node_pt) alloc;
+    // a boundary-tagged pool finds the header in front of the memory
+    if (pool_mgr->flags & POOL_BOUNDARY_TAGS) {
+        tag_pt tag = _mem_find_tag(pool_mgr, mem);
+        if (tag == NULL)
+            return ALLOC_FAIL;
 
-    // find the node in the node heap
-    // find the node in the node heap
+        _mem_del_tagged_alloc(pool_mgr, tag);
+        return ALLOC_OK;
+    }
 
-    int i = 0;
-    int del = -1;
-    while(pool_mgr->total_nodes) {
+    // a compact pool finds the segment by its offset
+    if (pool_mgr->flags & POOL_COMPACT_NODES) {
+        unsigned pos = _mem_find_compact_seg(pool_mgr, mem);
+        if (pos == MEM_COMPACT_NIL)
+            return ALLOC_FAIL;
 
-        if (&pool_mgr->node_heap[i] == node) {
-            del = i;
-            break;
-        }
-        i++;
+        _mem_del_compact_alloc(pool_mgr, pos);
+        return ALLOC_OK;
     }
 
-    // make sure it's found
-    if (del == -1) {
-        return ALLOC_FAIL;
+    // a bitmap pool looks up the record by the address
+    if (pool->policy == BITMAP) {
+        alloc_pt alloc = _mem_find_in_addr_ix(pool_mgr, mem);
+        if (alloc == NULL)
+            return ALLOC_FAIL;
+
+        _mem_del_bitmap_alloc(pool_mgr, alloc);
+        return ALLOC_OK;
     }
 
-    // convert to gap node
-    // update metadata (num_allocs, alloc_size)
-    node->used = 1;
-    node->allocated = 0;
-    pool->num_allocs--;
-    pool->alloc_size -= alloc->size;
+    // a slab pool finds the slot by dividing the offset
+    if (pool->policy == SLAB) {
+        slab_slot_pt slot = _mem_find_slab_slot(pool_mgr, mem);
+        if (slot == NULL)
+            return ALLOC_FAIL;
 
-    // if the next node in the list is also a gap, merge into node-to-delete
-    if (node->next != NULL && node->next->allocated == 0) {
+        _mem_del_slab_alloc(pool_mgr, slot);
+        return ALLOC_OK;
+    }
 
-        //   add the size to the node-to-delete
-        alloc->size += node->next->alloc_record.size;
+    // look up the record of the allocation by its address
+    alloc_pt alloc = _mem_find_in_addr_ix(pool_mgr, mem);
+    if (alloc == NULL)
+        return ALLOC_FAIL;
 
-        //   remove the next node from gap index
-        _mem_remove_from_gap_ix(pool_mgr, node->next->alloc_record.size, node->next);
+    return mem_del_alloc(pool, alloc);
+}
 
 
-        //   update node as unused
-        node->next->used = 0;
-        node->next->alloc_record.size = 0;
-        node->next->alloc_record.mem = NULL;
+alloc_pt mem_new_alloc_aligned(pool_pt pool, size_t size, size_t alignment) {
 
-        //   update metadata (used nodes)
-        pool_mgr->used_nodes--;
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
+    // the alignment has to be a power of 2, and the size padded by the
+    // most the alignment can take has to fit a size_t
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+        size == 0 || size > (size_t) -1 - (alignment - 1))
+        return NULL;
 
-        //   update linked list:
-        if (node->next->next == NULL) {
+    // the padding is split off into a gap of the node list, which a buddy
+    // pool can't do (its blocks only split in halves)
+    if ((pool_mgr->flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES)) ||
+        pool->policy == BUDDY || pool->policy == SLAB || pool->policy == BITMAP)
+        return NULL;
 
-            node->next->prev = NULL;
-            node->next = NULL;
+    // check if any gaps (or blocks on the quick lists), return null if none
+    // (a growable or reserving pool can always try to grow)
+    if (pool->num_gaps == 0 && pool_mgr->num_quick == 0 &&
+        !(pool_mgr->flags & (POOL_GROWABLE | POOL_RESERVE)))
+        return NULL;
 
-        }
+    // expand node heap, address index and gap index, if necessary, quit
+    // on error
+    if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL ||
+        _mem_resize_addr_ix(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+    if ((pool->policy == FIRST_FIT || pool->policy == BEST_FIT || pool->policy == NEXT_FIT) &&
+        _mem_resize_gap_ix(pool_mgr) == ALLOC_FAIL)
+        return NULL;
 
-        else {
-            node->next->next->prev = node;
-            node->next = node->next->next;
-        }
+    // get the gap the policy picks for the size padded by the most the
+    // alignment can take, which surely fits, else the first gap in address
+    // order that fits once aligned
+    node_pt node_alloc = _mem_find_gap(pool_mgr, size + alignment - 1);
+    if (node_alloc == NULL)
+        node_alloc = _mem_find_aligned_gap(pool_mgr, size, alignment);
 
+    // check if node found
+    // (if not, coalescing the quick lists may make room, and else a
+    // growable or reserving pool grows, as for an allocation of the padded
+    // size, which surely fits)
+    if (node_alloc == NULL && pool_mgr->num_quick > 0) {
+        _mem_flush_quick_lists(pool_mgr);
+        return mem_new_alloc_aligned(pool, size, alignment);
     }
+    if (node_alloc == NULL && (pool_mgr->flags & POOL_GROWABLE))
+        node_alloc = _mem_add_arena(pool_mgr, size + alignment - 1);
+    if (node_alloc == NULL && (pool_mgr->flags & POOL_RESERVE))
+        node_alloc = _mem_commit_reserve(pool_mgr, size + alignment - 1);
+    if (node_alloc == NULL)
+        return NULL;
 
+    // split the padding in front of the aligned address off the gap, and
+    // allocate from the rest of it
+    size_t padding = _mem_align_padding(node_alloc->alloc_record.mem, alignment);
+    if (padding > 0) {
 
+        //   take an unused node off the stack for the rest, and make sure
+        //   another is left for its remaining gap before splitting anything
+        node_pt rest = _mem_pop_unused_node(pool_mgr);
+        if (rest == NULL)
+            return NULL;
+        if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL) {
+            _mem_push_unused_node(pool_mgr, rest);
+            return NULL;
+        }
 
-    // this merged node-to-delete might need to be added to the gap index
-    // but one more thing to check...
-    // if the previous node in the list is also a gap, merge into previous!
+        //   shrink the gap to the padding, out of the index while its key
+        //   changes
+        _mem_remove_gap(pool_mgr, node_alloc->alloc_record.size, node_alloc);
+        rest->alloc_record.mem = node_alloc->alloc_record.mem + padding;
+        rest->alloc_record.size = node_alloc->alloc_record.size - padding;
+        rest->used = 1;
+        rest->allocated = 0;
+        rest->next_gap = NULL;
+        rest->prev_gap = NULL;
+        node_alloc->alloc_record.size = padding;
 
-    if (node->prev != NULL && node->prev->allocated == 0) {
+        //   update metadata (used_nodes)
+        //   update linked list (rest right after the padding)
+        pool_mgr->used_nodes++;
+        rest->prev = node_alloc;
+        rest->next = node_alloc->next;
+        if (node_alloc->next != NULL)
+            node_alloc->next->prev = rest;
+        else
+            pool_mgr->last_node = rest;
+        node_alloc->next = rest;
+
+        //   both are gaps now
+        _mem_add_gap(pool_mgr, padding, node_alloc);
+        _mem_add_gap(pool_mgr, rest->alloc_record.size, rest);
+        node_alloc = rest;
+    }
 
-        //   add the size of node-to-delete to the previous
-        node->prev->alloc_record.size += alloc->size;
+    // carve the allocation out of the start of the gap
+    return _mem_alloc_from_gap(pool_mgr, node_alloc, size);
+}
 
 
-        //   remove the previous node from gap index
-        if (_mem_remove_from_gap_ix(pool_mgr,
-                                    node->prev->alloc_record.size - alloc->size,
-                                    node->prev) == ALLOC_FAIL) {
-            return ALLOC_FAIL;
-        }
+alloc_pt mem_resize_alloc(pool_pt pool, alloc_pt alloc, size_t size) {
 
-        //   update node-to-delete as unused
-        node->alloc_record.size = 0;
-        node->used = 0;
-        node->alloc_record.mem = NULL;
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
-        //   update metadata (used_nodes)
-        pool_mgr->used_nodes--;
+    // make sure it's a live allocation of this pool, and the size is not
+    // 0 (empty allocations are refused)
+    if (size == 0 || !_mem_is_live_alloc(pool_mgr, alloc))
+        return NULL;
 
-        //   update linked list
-        if (node->next == NULL) {
-            node->prev->next = NULL;
-        }
+    // an allocation from the node heap is resized in place, if it can be
+    // (a buddy block only if it stays the same block size)
+    if (!(pool_mgr->flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES)) &&
+        pool->policy != SLAB && pool->policy != BITMAP) {
+        node_pt node = (node_pt) alloc;
 
-        else {
-            node->prev->next = node->next;
-            node->next->prev = node->prev;
+        if (pool->policy == BUDDY) {
+            if (_mem_buddy_size(size) == alloc->size)
+                return alloc;
+        }
+        else if (size == alloc->size) {
+            return alloc;
         }
 
+        // shrinking splits off the end into a gap
+        else if (size < alloc->size) {
+            if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL ||
+                ((pool->policy == FIRST_FIT || pool->policy == BEST_FIT || pool->policy == NEXT_FIT) &&
+                 _mem_resize_gap_ix(pool_mgr) == ALLOC_FAIL))
+                return NULL;
 
+            return (_mem_shrink_alloc(pool_mgr, node, size) == ALLOC_OK) ? alloc : NULL;
+        }
 
-        //   change the node to add to the previous node!
-        node = node->prev;
+        // growing takes the start of the gap after it, if that's enough
+        else if (_mem_grow_alloc(pool_mgr, node, size) == ALLOC_OK) {
+            return alloc;
+        }
     }
 
+    // otherwise, allocate anew, copy over what fits, and deallocate
+    alloc_pt new_alloc = mem_new_alloc(pool, size);
+    if (new_alloc == NULL)
+        return NULL;
 
-    // add the resulting node to the gap index
-    _mem_add_to_gap_ix(pool_mgr, node->alloc_record.size, node);
-    return ALLOC_OK;
-}
+    memcpy(new_alloc->mem, alloc->mem, (size < alloc->size) ? size : alloc->size);
+    mem_del_alloc(pool, alloc);
 
+    return new_alloc;
+}
 
-void mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments) {
 
+alloc_status mem_pool_trim(pool_pt pool) {
 
-    // get the mgr from the pool
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
     pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
 
+    if (pool == NULL)
+        return ALLOC_FAIL;
+
+    // from now on, the zero ranges are kept, so the pages released are
+    // recorded
+    pool_mgr->zero_tracking = 1;
+
+    // coalesce the quick lists first, which may leave arenas idle
+    if (pool_mgr->num_quick > 0)
+        _mem_flush_quick_lists(pool_mgr);
+
+    // unmap every arena that's a single gap, but the pool memory itself
+    unsigned a = 0;
+    while (a < pool_mgr->num_arenas) {
+        arena_pt arena = &pool_mgr->arenas[a];
+        if (arena->mem != pool->mem && arena->first->allocated == 0 &&
+            arena->first->alloc_record.size == arena->size)
+            _mem_remove_arena(pool_mgr, a);
+        else
+            a++;
+    }
+
+    // give back the pages of the gaps, found through the gap index (and
+    // the wilderness) or the bins
+    if (pool_mgr->gap_ix != NULL) {
+        for (unsigned slot = 0; slot < pool_mgr->gap_ix_size; ++slot)
+            _mem_release_gap(pool_mgr, pool_mgr->gap_ix[slot].node);
+        if (pool_mgr->wilderness != NULL)
+            _mem_release_gap(pool_mgr, pool_mgr->wilderness);
+    }
+    else if (pool_mgr->gap_bins != NULL) {
+        for (unsigned bin = 0; bin < pool_mgr->num_gap_bins; ++bin) {
+            node_pt node = pool_mgr->gap_bins[bin];
+            while (node != NULL) {
+                _mem_release_gap(pool_mgr, node);
+                node = node->next_gap;
+            }
+        }
+    }
+
+    return ALLOC_OK;
+}
+
+
+alloc_pt mem_new_alloc_zeroed(pool_pt pool, size_t size) {
+
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
+
+    // allocate, having the memory taken out of the gaps zeroed where it's
+    // not known to be zero already (from now on, the zero ranges are kept)
+    pool_mgr->zero_tracking = 1;
+    pool_mgr->zero_pending = 1;
+    alloc_pt alloc = mem_new_alloc(pool, size);
+
+    // anything else (a reused block, or a pool without zero ranges) is
+    // zeroed whole
+    if (alloc != NULL && pool_mgr->zero_pending)
+        memset(alloc->mem, 0, alloc->size);
+    pool_mgr->zero_pending = 0;
+
+    return alloc;
+}
+
+
+void mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments) {
+
+
+    // get the mgr from the pool
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
+
+    // show the pool with its quick lists coalesced
+    if (pool_mgr->num_quick > 0)
+        _mem_flush_quick_lists(pool_mgr);
+
     // allocate the segments array with size == used_nodes
-    pool_segment_pt poolSegs = (pool_segment_pt) calloc(pool_mgr->used_nodes, sizeof(pool_segment_t));
+    // (a boundary-tagged, compact or bitmap pool has no nodes, but one
+    // segment per allocation and gap, and a slab pool one per slot and
+    // per gap)
+    unsigned num_segs = ((pool_mgr->flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES)) ||
+                         pool->policy == SLAB || pool->policy == BITMAP) ?
+                        pool->num_allocs + pool->num_gaps : pool_mgr->used_nodes;
+    pool_segment_pt poolSegs = (pool_segment_pt) calloc(num_segs, sizeof(pool_segment_t));
 
     // check successful
     if (poolSegs == NULL) {
         return;
     }
 
+    // walk the tags of a boundary-tagged pool, segment after segment: an
+    // allocation is reported at its size, like in a node-heap pool, and its
+    // tags and padding are counted in the gap after it (at the end of the
+    // pool, in the last gap), so the sizes still add up to the pool's, if
+    // there is a gap
+    if (pool_mgr->flags & POOL_BOUNDARY_TAGS) {
+        char *seg = pool->mem;
+        size_t overhead = 0;
+        unsigned last_gap = num_segs;
+        unsigned u = 0;
+        while (u < num_segs) {
+            tag_pt tag = (tag_pt) seg;
+            size_t length = tag->length & ~(size_t) 1;
+            poolSegs[u].allocated = tag->length & 1;
+            if (poolSegs[u].allocated) {
+                poolSegs[u].size = tag->alloc_record.size;
+                overhead += length - tag->alloc_record.size;
+            }
+            else {
+                poolSegs[u].size = length + overhead;
+                overhead = 0;
+                last_gap = u;
+            }
+            seg += length;
+            u++;
+        }
+        if (last_gap < num_segs)
+            poolSegs[last_gap].size += overhead;
+
+        *num_segments = num_segs;
+        *segments = poolSegs;
+        return;
+    }
+
+    // copy the segment arrays of a compact pool
+    if (pool_mgr->flags & POOL_COMPACT_NODES) {
+        unsigned u = 0;
+        while (u < num_segs) {
+            poolSegs[u].size = pool_mgr->compact_sizes[u];
+            poolSegs[u].allocated = (pool_mgr->compact_allocated[u / 64] >> (u % 64)) & 1;
+            u++;
+        }
+
+        *num_segments = num_segs;
+        *segments = poolSegs;
+        return;
+    }
+
+    // find the runs in the bitmap of a bitmap pool: a gap runs to the next
+    // allocated granule, and an allocation to the next free granule or the
+    // start of the next allocation, whichever comes first
+    if (pool->policy == BITMAP) {
+        size_t n = pool_mgr->num_granules;
+        uint64_t *free_bits = pool_mgr->bitmap_levels[0].bits;
+        size_t i = 0;
+        unsigned u = 0;
+        while (u < num_segs) {
+            size_t end;
+            if ((free_bits[i / 64] >> (i % 64)) & 1) {
+                end = _mem_next_bit(free_bits, i, n, 0);
+            }
+            else {
+                end = _mem_next_bit(free_bits, i, n, 1);
+                end = _mem_next_bit(pool_mgr->bitmap_starts, i + 1, end, 1);
+            }
+            poolSegs[u].size = (end - i) * pool_mgr->bitmap_granule;
+            poolSegs[u].allocated = !((free_bits[i / 64] >> (i % 64)) & 1);
+            i = end;
+            u++;
+        }
+
+        *num_segments = num_segs;
+        *segments = poolSegs;
+        return;
+    }
+
+    // list the slots of a slab pool in order, and then the tail that's
+    // too short for another slot, if any
+    if (pool->policy == SLAB) {
+        unsigned u = 0;
+        while (u < pool_mgr->num_slab_slots) {
+            poolSegs[u].size = pool_mgr->slab_object_size;
+            poolSegs[u].allocated = (pool_mgr->slab_slots[u].alloc_record.size != 0);
+            u++;
+        }
+        if (u < num_segs)
+            poolSegs[u].size = pool->total_size % pool_mgr->slab_object_size;
+
+        *num_segments = num_segs;
+        *segments = poolSegs;
+        return;
+    }
+
     // loop through the node heap and the segments array
-    node_pt node = pool_mgr->node_heap;
+    // (from the first node of the lowest arena, in a growable pool)
+    node_pt node = _mem_first_node(pool_mgr);
     int segsCount = 0;
 
 
@@ -530,6 +1335,92 @@ void mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_seg
 
 }
 
+alloc_status mem_search_segments(search_kernel kernel, const uint32_t *sizes, const uint64_t *allocated,
+                                 unsigned from, unsigned n, uint32_t size, unsigned *found) {
+
+    // take the kernel asked for, if it's compiled in and the CPU runs it
+    fit_kernel_t search = NULL;
+    if (kernel == KERNEL_SCALAR)
+        search = _mem_find_fit_scalar;
+#ifdef MEM_X86_SIMD
+    __builtin_cpu_init();
+    if (kernel == KERNEL_SSE2 && __builtin_cpu_supports("sse2"))
+        search = _mem_find_fit_sse2;
+    if (kernel == KERNEL_AVX2 && __builtin_cpu_supports("avx2"))
+        search = _mem_find_fit_avx2;
+#endif
+    if (search == NULL || size == 0 || from > n)
+        return ALLOC_FAIL;
+
+    // n if no segment fits
+    unsigned pos = search(sizes, allocated, from, n, size);
+    *found = (pos == MEM_COMPACT_NIL) ? n : pos;
+
+    return ALLOC_OK;
+}
+
+
+alloc_status mem_check_pool(pool_pt pool) {
+
+    // get mgr from pool by casting the pointer to (pool_mgr_pt)
+    pool_mgr_pt pool_mgr = (pool_mgr_pt) pool;
+
+    // only the pools of the node heap have a node list to check
+    if (pool_mgr->flags & (POOL_BOUNDARY_TAGS | POOL_COMPACT_NODES) ||
+        pool->policy == SLAB || pool->policy == BITMAP)
+        return ALLOC_FAIL;
+
+    int has_gap_ix = (pool->policy == FIRST_FIT || pool->policy == BEST_FIT ||
+                      pool->policy == NEXT_FIT);
+
+    // walk the node list: it's linked both ways, the nodes of an arena
+    // follow each other in memory, and the counts match the metadata
+    node_pt node = _mem_first_node(pool_mgr);
+    node_pt prev = NULL;
+    unsigned num_nodes = 0, num_gaps = 0, num_allocs = 0, num_indexed = 0;
+    while (node != NULL) {
+        if (node->used == 0 || node->prev != prev ||
+            (prev != NULL && !node->arena_start &&
+             prev->alloc_record.mem + prev->alloc_record.size != node->alloc_record.mem))
+            return ALLOC_FAIL;
+
+        if (node->allocated) {
+            num_allocs++;
+        } else {
+            num_gaps++;
+
+            // a gap of the index is the node of its entry, and it's
+            // merged with the gaps around it, except across arenas
+            if (has_gap_ix && node != pool_mgr->wilderness) {
+                if (node->gap_slot >= pool_mgr->gap_ix_size ||
+                    pool_mgr->gap_ix[node->gap_slot].node != node ||
+                    pool_mgr->gap_ix[node->gap_slot].size != node->alloc_record.size)
+                    return ALLOC_FAIL;
+                num_indexed++;
+            }
+            if (has_gap_ix && prev != NULL && !prev->allocated && !node->arena_start)
+                return ALLOC_FAIL;
+        }
+
+        num_nodes++;
+        prev = node;
+        node = node->next;
+    }
+    if (prev != pool_mgr->last_node || num_nodes != pool_mgr->used_nodes ||
+        num_gaps != pool->num_gaps || num_allocs != pool->num_allocs + pool_mgr->num_quick)
+        return ALLOC_FAIL;
+
+    // the gap index is an AVL tree over exactly the gaps counted
+    if (has_gap_ix) {
+        unsigned prev_slot = MEM_GAP_IX_NIL, count = 0;
+        if (!_mem_check_gap_ix(pool_mgr, pool_mgr->gap_ix_root, MEM_GAP_IX_NIL, &prev_slot, &count) ||
+            count != pool_mgr->gap_ix_size || num_indexed != pool_mgr->gap_ix_size)
+            return ALLOC_FAIL;
+    }
+
+    return ALLOC_OK;
+}
+
 
 /***********************************/
 /*                                 */
@@ -558,129 +1449,2577 @@ static alloc_status _mem_resize_pool_store() {
     return ALLOC_OK;
 }
 
-static alloc_status _mem_resize_node_heap(pool_mgr_pt pool_mgr) {
+static void _mem_free_pool_mgr(pool_mgr_pt pool_mgr) {
 
-    // check if necessary
-    if (((float) pool_mgr->used_nodes / pool_mgr->total_nodes) > MEM_NODE_HEAP_FILL_FACTOR) {
+    // free memory pool
+    // free node heap
+    // free gap index, address index and bins
+    // free mgr
+    _mem_unmap(pool_mgr->pool.mem, pool_mgr->mapped_size);
+    for (unsigned a = 0; a < pool_mgr->num_arenas; ++a) {
+        if (pool_mgr->arenas[a].mem != pool_mgr->pool.mem)
+            _mem_unmap(pool_mgr->arenas[a].mem, pool_mgr->arenas[a].mapped_size);
+    }
+    free(pool_mgr->arenas);
+    free(pool_mgr->zero_ranges);
+    while (pool_mgr->node_heap != NULL) {
+        node_chunk_pt next = pool_mgr->node_heap->next;
+        free(pool_mgr->node_heap);
+        pool_mgr->node_heap = next;
+    }
+    free(pool_mgr->gap_ix);
+    free(pool_mgr->addr_ix);
+    free(pool_mgr->gap_bins);
+    free(pool_mgr->gap_bin_sl_map);
+    free(pool_mgr->quick_lists);
+    free(pool_mgr->slab_slots);
+    free(pool_mgr->compact_sizes);
+    free(pool_mgr->compact_allocated);
+    free(pool_mgr->compact_offsets);
+    free(pool_mgr->compact_records);
+    if (pool_mgr->bitmap_levels != NULL) {
+        unsigned level = 0;
+        while (level < pool_mgr->num_bitmap_levels)
+            free(pool_mgr->bitmap_levels[level++].bits);
+    }
+    free(pool_mgr->bitmap_levels);
+    free(pool_mgr->bitmap_starts);
+    while (pool_mgr->record_heap != NULL) {
+        record_chunk_pt next = pool_mgr->record_heap->next;
+        free(pool_mgr->record_heap);
+        pool_mgr->record_heap = next;
+    }
+    free(pool_mgr);
+}
+
+static char *_mem_map(size_t size, int huge, pool_backing *backing, size_t *mapped_size) {
+
+    // an empty pool still gets a byte, to have an address of its own
+    if (size == 0)
+        size = 1;
+
+#ifdef MEM_MMAP
+    // huge pages come whole, and aligned to their size
+    if (huge && size <= (size_t) -1 - 2 * MEM_HUGE_PAGE_SIZE) {
+        size_t length = (size + MEM_HUGE_PAGE_SIZE - 1) & ~(MEM_HUGE_PAGE_SIZE - 1);
+        void *mem;
+
+#ifdef MAP_HUGETLB
+        // explicit huge pages, if enough of them are reserved
+        mem = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            *backing = BACKING_HUGETLB;
+            *mapped_size = length;
+            return (char *) mem;
+        }
+#endif
+
+#ifdef MADV_HUGEPAGE
+        // else normal pages, with a huge page of slack to cut the mapping
+        // down to an aligned one, which the kernel is asked to back with
+        // transparent huge pages
+        mem = mmap(NULL, length + MEM_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem != MAP_FAILED) {
+            char *start = (char *) mem;
+            char *aligned = (char *) (((uintptr_t) start + MEM_HUGE_PAGE_SIZE - 1) &
+                                      ~(uintptr_t) (MEM_HUGE_PAGE_SIZE - 1));
+            if (aligned > start)
+                munmap(start, aligned - start);
+            if (start + MEM_HUGE_PAGE_SIZE > aligned)
+                munmap(aligned + length, start + MEM_HUGE_PAGE_SIZE - aligned);
+
+            *backing = (madvise(aligned, length, MADV_HUGEPAGE) == 0) ?
+                       BACKING_THP_ADVISED : BACKING_PAGES;
+            *mapped_size = length;
+            return aligned;
+        }
+#endif
+    }
 
+    // anonymous pages are zeroed by the kernel when first touched, so
+    // mapping any size costs the same, and nothing is committed up front
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
 
-        // reallocate w/ size expanded by expand factor
-        //update capacity
-        pool_mgr->node_heap = realloc(pool_mgr->node_heap, sizeof(node_t) * pool_mgr->total_nodes * MEM_NODE_HEAP_EXPAND_FACTOR);
-        pool_mgr->total_nodes *= MEM_NODE_HEAP_EXPAND_FACTOR;
+    *backing = BACKING_PAGES;
+    *mapped_size = size;
+    return (char *) mem;
+#else
+    *backing = BACKING_HEAP;
+    *mapped_size = size;
+    return (char *) calloc(size, sizeof(char));
+#endif
+}
+
+static void _mem_unmap(char *mem, size_t mapped_size) {
+
+    if (mem == NULL)
+        return;
+
+#ifdef MEM_MMAP
+    munmap(mem, mapped_size);
+#else
+    (void) mapped_size;
+    free(mem);
+#endif
+}
+
+static node_pt _mem_add_arena(pool_mgr_pt pool_mgr, size_t size) {
+
+    // an arena is at least as large as the pool was opened with
+    size_t length = (size > pool_mgr->arena_size) ? size : pool_mgr->arena_size;
+
+    // expand the arena array and node heap, if necessary, quit on error
+    // (before anything is mapped)
+    if (pool_mgr->num_arenas == pool_mgr->arena_capacity) {
+        unsigned capacity = pool_mgr->arena_capacity * MEM_ARENA_EXPAND_FACTOR;
+        arena_pt arenas = realloc(pool_mgr->arenas, capacity * sizeof(arena_t));
+        if (arenas == NULL)
+            return NULL;
+
+        pool_mgr->arenas = arenas;
+        pool_mgr->arena_capacity = capacity;
     }
+    if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
 
-    if (pool_mgr->node_heap == NULL)
-        return ALLOC_FAIL;
+    // map it like the pool memory
+    pool_backing backing;
+    size_t mapped_size;
+    char *mem = _mem_map(length, pool_mgr->flags & POOL_HUGE_PAGES, &backing, &mapped_size);
+    if (mem == NULL)
+        return NULL;
+
+    // it's a single gap, with a node of its own
+    node_pt node = _mem_pop_unused_node(pool_mgr);
+    node->alloc_record.mem = mem;
+    node->alloc_record.size = length;
+    node->used = 1;
+    node->allocated = 0;
+    node->arena_start = 1;
+    node->next_gap = NULL;
+    node->prev_gap = NULL;
+    pool_mgr->used_nodes++;
+
+    // insert it into the arena array, in address order
+    unsigned a = pool_mgr->num_arenas;
+    while (a > 0 && pool_mgr->arenas[a - 1].mem > mem) {
+        pool_mgr->arenas[a] = pool_mgr->arenas[a - 1];
+        a--;
+    }
+    pool_mgr->arenas[a].mem = mem;
+    pool_mgr->arenas[a].size = length;
+    pool_mgr->arenas[a].mapped_size = mapped_size;
+    pool_mgr->arenas[a].first = node;
+    pool_mgr->num_arenas++;
+
+    // and its node into the list, in address order too: right before the
+    // first node of the next arena up, or else at the end
+    node_pt next = (a + 1 < pool_mgr->num_arenas) ? pool_mgr->arenas[a + 1].first : NULL;
+    node_pt prev = (next != NULL) ? next->prev : pool_mgr->last_node;
+
+    //   a gap that ended the list doesn't any more, so it goes from the
+    //   wilderness to the gap index
+    int was_last = (prev != NULL && prev == pool_mgr->wilderness);
+    if (was_last)
+        _mem_remove_gap(pool_mgr, prev->alloc_record.size, prev);
+
+    node->prev = prev;
+    node->next = next;
+    if (prev != NULL)
+        prev->next = node;
+    if (next != NULL)
+        next->prev = node;
+    else
+        pool_mgr->last_node = node;
+
+    if (was_last && _mem_add_gap(pool_mgr, prev->alloc_record.size, prev) == ALLOC_FAIL)
+        return NULL;
+    if (_mem_add_gap(pool_mgr, length, node) == ALLOC_FAIL)
+        return NULL;
 
+    // update metadata (total_size)
+    // (its memory is all zeros, as mapped)
+    pool_mgr->pool.total_size += length;
+    _mem_add_zero_range(pool_mgr, mem, length);
 
+    // leave a node for the gap an allocation from it leaves
+    if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
 
-    return ALLOC_OK;
+    return node;
 }
 
-static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr) {
+static char *_mem_reserve(size_t reserve_size, size_t size, size_t *committed_size) {
 
+#ifdef MEM_MMAP
+    // the range is address space only: no access, and nothing committed or
+    // accounted for until it's made accessible
+    void *mem = mmap(NULL, reserve_size, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
 
-    // check if necessary
-    if (((float) pool_mgr->pool.num_gaps / pool_mgr->gap_ix_capacity) > MEM_GAP_IX_FILL_FACTOR) {
+    // make the pages the pool starts out with accessible
+    size_t page = _mem_page_size();
+    size_t commit = (size + page - 1) / page * page;
+    if (commit > 0 && mprotect(mem, commit, PROT_READ | PROT_WRITE) != 0) {
+        munmap(mem, reserve_size);
+        return NULL;
+    }
 
+    *committed_size = commit;
+    return (char *) mem;
+#else
+    // nothing to reserve with
+    (void) reserve_size;
+    (void) size;
+    (void) committed_size;
+    return NULL;
+#endif
+}
 
-        // reallocate w/ size expanded by expand factor
-        //update capacity
-        pool_mgr->gap_ix = realloc(&pool_mgr->gap_ix_capacity, sizeof(gap_t) * pool_mgr->pool.num_gaps * MEM_GAP_IX_EXPAND_FACTOR);
-        pool_mgr->gap_ix_capacity *= MEM_GAP_IX_EXPAND_FACTOR;
+static node_pt _mem_commit_reserve(pool_mgr_pt pool_mgr, size_t size) {
+
+#ifdef MEM_MMAP
+    // the last node, which ends the pool
+    node_pt last = pool_mgr->last_node;
+
+    // a gap at the end only lacks the rest of the size
+    // (it may fit already, and just be in a size class the search skipped)
+    size_t have = (last->allocated == 0) ? last->alloc_record.size : 0;
+    if (have >= size)
+        return last;
+    size_t need = size - have;
+
+    // grow by the size of the pool, or what's needed if more, within the
+    // reservation
+    size_t total = pool_mgr->pool.total_size;
+    size_t delta = (need > total) ? need : total;
+    if (delta > pool_mgr->mapped_size - total)
+        delta = pool_mgr->mapped_size - total;
+    if (delta < need)
+        return NULL;
+
+    // make the pages it reaches into accessible
+    size_t page = _mem_page_size();
+    size_t commit = (total + delta + page - 1) / page * page;
+    if (commit > pool_mgr->committed_size) {
+        if (mprotect(pool_mgr->pool.mem + pool_mgr->committed_size, commit - pool_mgr->committed_size,
+                     PROT_READ | PROT_WRITE) != 0)
+            return NULL;
+        pool_mgr->committed_size = commit;
     }
 
-    if (pool_mgr->gap_ix == NULL)
-        return ALLOC_FAIL;
+    // the gap at the end grows in place, out of the index while its key
+    // changes, or else a new one starts at the end
+    if (last->allocated == 0) {
+        _mem_remove_gap(pool_mgr, last->alloc_record.size, last);
+        last->alloc_record.size += delta;
+    }
+    else {
+        node_pt gap = _mem_pop_unused_node(pool_mgr);
+        if (gap == NULL)
+            return NULL;
 
+        gap->alloc_record.mem = pool_mgr->pool.mem + total;
+        gap->alloc_record.size = delta;
+        gap->used = 1;
+        gap->allocated = 0;
+        gap->next_gap = NULL;
+        gap->prev_gap = NULL;
+
+        //   update metadata (used_nodes)
+        //   update linked list (gap at the end)
+        pool_mgr->used_nodes++;
+        gap->prev = last;
+        gap->next = NULL;
+        last->next = gap;
+        pool_mgr->last_node = gap;
+        last = gap;
+    }
+    if (_mem_add_gap(pool_mgr, last->alloc_record.size, last) == ALLOC_FAIL)
+        return NULL;
 
+    // update metadata (total_size)
+    // (the memory past the old end was never used, so it's all zeros)
+    _mem_add_zero_range(pool_mgr, pool_mgr->pool.mem + total, delta);
+    pool_mgr->pool.total_size += delta;
 
-    return ALLOC_OK;
+    // leave a node for the gap an allocation from it leaves
+    if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+
+    return last;
+#else
+    (void) pool_mgr;
+    (void) size;
+    return NULL;
+#endif
 }
 
-static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
-    // expand the gap index, if necessary (call the function)
-    _mem_resize_gap_ix(pool_mgr);
+static size_t _mem_page_size() {
 
-    // add the entry at the end
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].node = node;
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].size = size;
-    pool_mgr->pool.num_gaps++;
+#ifdef MEM_MMAP
+    long page = sysconf(_SC_PAGESIZE);
+    return (page > 0) ? (size_t) page : 4096;
+#else
+    return 4096;
+#endif
+}
 
-    // sort the gap index (call the function)
-    // check success
-    if(_mem_sort_gap_ix(pool_mgr) == ALLOC_FAIL)
-        return ALLOC_FAIL;
+static void _mem_release_gap(pool_mgr_pt pool_mgr, node_pt node) {
+
+#ifdef MEM_MADV_RELEASE
+    // only the whole pages inside the gap
+    uintptr_t page = _mem_page_size();
+    uintptr_t start = ((uintptr_t) node->alloc_record.mem + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) node->alloc_record.mem + node->alloc_record.size) & ~(page - 1);
+    if (end <= start)
+        return;
 
+    // skip the parts already known to be zero, releasing the pages around
+    // each one
+    int released = 1;
+    uintptr_t cursor = start;
+    unsigned r = _mem_find_zero_range(pool_mgr, (char *) start);
+    while (cursor < end) {
+        uintptr_t next = end;
+        if (r < pool_mgr->num_zero_ranges && (uintptr_t) pool_mgr->zero_ranges[r].mem < end)
+            next = (uintptr_t) pool_mgr->zero_ranges[r].mem;
+
+        if (next > cursor) {
+            uintptr_t from = cursor & ~(page - 1);
+            uintptr_t to = (next + page - 1) & ~(page - 1);
+            if (to > end)
+                to = end;
+            if (madvise((void *) from, to - from, MEM_MADV_RELEASE) != 0)
+                released = 0;
+        }
 
+        if (next == end)
+            break;
+        cursor = (uintptr_t) pool_mgr->zero_ranges[r].mem + pool_mgr->zero_ranges[r].size;
+        r++;
+    }
 
-    return ALLOC_OK;
+#ifdef MEM_MADV_ZEROES
+    // the pages read as zeros now
+    if (released)
+        _mem_add_zero_range(pool_mgr, (char *) start, end - start);
+#else
+    (void) released;
+#endif
+#else
+    (void) pool_mgr;
+    (void) node;
+#endif
 }
 
-static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+static unsigned _mem_find_zero_range(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // binary search for the first range that ends after mem
+    unsigned lo = 0, hi = pool_mgr->num_zero_ranges;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        zero_range_pt range = &pool_mgr->zero_ranges[mid];
+        if ((uintptr_t) range->mem + range->size <= (uintptr_t) mem)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
+    return lo;
+}
 
-    // find the position of the node in the gap index
-    int i = 0;
-    int indexOfNode = -1;
+static void _mem_add_zero_range(pool_mgr_pt pool_mgr, char *mem, size_t size) {
 
-    while( i < pool_mgr->gap_ix_capacity){
-        if (pool_mgr->gap_ix[i].node == node){
-            indexOfNode = i;
+    if (size == 0 || pool_mgr->zero_ranges == NULL)
+        return;
+
+    // the ranges it overlaps or touches, from the first that ends at or
+    // after mem to the last that starts at or before its end
+    uintptr_t start = (uintptr_t) mem;
+    uintptr_t end = start + size;
+    unsigned lo = _mem_find_zero_range(pool_mgr, mem);
+    if (lo > 0 && (uintptr_t) pool_mgr->zero_ranges[lo - 1].mem + pool_mgr->zero_ranges[lo - 1].size == start)
+        lo--;
+    unsigned hi = lo;
+    while (hi < pool_mgr->num_zero_ranges && (uintptr_t) pool_mgr->zero_ranges[hi].mem <= end)
+        hi++;
+
+    // none: insert it, expanding the array if necessary (and if that
+    // fails, just forget it, which is always safe)
+    if (lo == hi) {
+        if (pool_mgr->num_zero_ranges == pool_mgr->zero_capacity) {
+            unsigned capacity = pool_mgr->zero_capacity * MEM_ZERO_EXPAND_FACTOR;
+            zero_range_pt ranges = realloc(pool_mgr->zero_ranges, capacity * sizeof(zero_range_t));
+            if (ranges == NULL)
+                return;
+
+            pool_mgr->zero_ranges = ranges;
+            pool_mgr->zero_capacity = capacity;
+        }
+
+        memmove(&pool_mgr->zero_ranges[lo + 1], &pool_mgr->zero_ranges[lo],
+                (pool_mgr->num_zero_ranges - lo) * sizeof(zero_range_t));
+        pool_mgr->zero_ranges[lo].mem = mem;
+        pool_mgr->zero_ranges[lo].size = size;
+        pool_mgr->num_zero_ranges++;
+        return;
+    }
+
+    // else merge them all into the first
+    zero_range_pt first = &pool_mgr->zero_ranges[lo];
+    zero_range_pt last = &pool_mgr->zero_ranges[hi - 1];
+    if ((uintptr_t) first->mem < start)
+        start = (uintptr_t) first->mem;
+    if ((uintptr_t) last->mem + last->size > end)
+        end = (uintptr_t) last->mem + last->size;
+    first->mem = (char *) start;
+    first->size = end - start;
+
+    memmove(&pool_mgr->zero_ranges[lo + 1], &pool_mgr->zero_ranges[hi],
+            (pool_mgr->num_zero_ranges - hi) * sizeof(zero_range_t));
+    pool_mgr->num_zero_ranges -= hi - lo - 1;
+}
+
+static void _mem_take_zero_ranges(pool_mgr_pt pool_mgr, char *mem, size_t size) {
+
+    // until a pool trims or zeroes, the memory it hands out just forgets
+    // all the ranges, so that the allocations of the pools that never use
+    // them don't search them
+    if (!pool_mgr->zero_tracking) {
+        pool_mgr->num_zero_ranges = 0;
+        return;
+    }
+
+    uintptr_t start = (uintptr_t) mem;
+    uintptr_t end = start + size;
+    unsigned r = _mem_find_zero_range(pool_mgr, mem);
+
+    // for mem_new_alloc_zeroed, zero what isn't known to be zero, between
+    // the ranges it overlaps
+    if (pool_mgr->zero_pending) {
+        uintptr_t cursor = start;
+        unsigned u = r;
+        while (u < pool_mgr->num_zero_ranges && (uintptr_t) pool_mgr->zero_ranges[u].mem < end) {
+            if ((uintptr_t) pool_mgr->zero_ranges[u].mem > cursor)
+                memset((char *) cursor, 0, (uintptr_t) pool_mgr->zero_ranges[u].mem - cursor);
+            cursor = (uintptr_t) pool_mgr->zero_ranges[u].mem + pool_mgr->zero_ranges[u].size;
+            u++;
+        }
+        if (cursor < end)
+            memset((char *) cursor, 0, end - cursor);
+
+        pool_mgr->zero_pending = 0;
+    }
+
+    // cut the memory out of the ranges it overlaps
+    while (r < pool_mgr->num_zero_ranges && (uintptr_t) pool_mgr->zero_ranges[r].mem < end) {
+        zero_range_pt range = &pool_mgr->zero_ranges[r];
+        uintptr_t range_start = (uintptr_t) range->mem;
+        uintptr_t range_end = range_start + range->size;
+
+        //   the part before it stays, and the part after it too, as a range
+        //   of its own (forgotten, if the array can't take it)
+        if (range_start < start) {
+            range->size = start - range_start;
+            r++;
+            if (range_end > end) {
+                _mem_add_zero_range(pool_mgr, (char *) end, range_end - end);
+                break;
+            }
+        }
+
+        //   only the part after it stays
+        else if (range_end > end) {
+            range->mem = (char *) end;
+            range->size = range_end - end;
             break;
         }
-        i++;
+
+        //   none of it stays
+        else {
+            memmove(range, range + 1, (pool_mgr->num_zero_ranges - r - 1) * sizeof(zero_range_t));
+            pool_mgr->num_zero_ranges--;
+        }
     }
+}
 
-    // loop from there to the end of the array
-    int j = indexOfNode;
-    while(j < pool_mgr ->gap_ix_capacity-1) {
-        pool_mgr->gap_ix[j] = pool_mgr->gap_ix[j + 1];
-        j++;
+static node_pt _mem_first_node(pool_mgr_pt pool_mgr) {
+
+    // the top node starts the pool memory, which in a growable pool may
+    // not be the lowest arena
+    return (pool_mgr->num_arenas > 0) ? pool_mgr->arenas[0].first : pool_mgr->node_heap->nodes;
+}
+
+static void _mem_remove_arena(pool_mgr_pt pool_mgr, unsigned a) {
+
+    arena_t arena = pool_mgr->arenas[a];
+    node_pt node = arena.first;
+    node_pt prev = node->prev;
+    node_pt next = node->next;
+
+    // take its gap out of the index
+    _mem_remove_gap(pool_mgr, node->alloc_record.size, node);
+
+    // and its node out of the list
+    //   a gap before it that ends the list now becomes the wilderness
+    int now_last = (next == NULL && prev != NULL && prev->allocated == 0);
+    if (now_last)
+        _mem_remove_gap(pool_mgr, prev->alloc_record.size, prev);
+
+    if (prev != NULL)
+        prev->next = next;
+    if (next != NULL)
+        next->prev = prev;
+    else
+        pool_mgr->last_node = prev;
+
+    if (now_last)
+        _mem_add_gap(pool_mgr, prev->alloc_record.size, prev);
+
+    //   update node as unused
+    //   update metadata (used_nodes)
+    _mem_push_unused_node(pool_mgr, node);
+    pool_mgr->used_nodes--;
+
+    // the next-fit cursor starts over if it was in the arena
+    if ((uintptr_t) pool_mgr->next_fit_cursor - (uintptr_t) arena.mem <= arena.size)
+        pool_mgr->next_fit_cursor = pool_mgr->pool.mem;
+
+    // unmap it, and take it out of the array and the zero ranges
+    _mem_take_zero_ranges(pool_mgr, arena.mem, arena.size);
+    _mem_unmap(arena.mem, arena.mapped_size);
+    pool_mgr->pool.total_size -= arena.size;
+    memmove(&pool_mgr->arenas[a], &pool_mgr->arenas[a + 1],
+            (pool_mgr->num_arenas - a - 1) * sizeof(arena_t));
+    pool_mgr->num_arenas--;
+}
+
+static alloc_status _mem_resize_node_heap(pool_mgr_pt pool_mgr) {
+
+    // check if necessary (no unused node left)
+    if (pool_mgr->unused_nodes == NULL) {
+
+        // allocate one more chunk
+        // (the nodes already there stay where they are)
+        node_chunk_pt chunk = calloc(1, sizeof(node_chunk_t) + MEM_NODE_HEAP_CHUNK_SIZE * sizeof(node_t));
+        if (chunk == NULL)
+            return ALLOC_FAIL;
+
+        // link it in after the first one, which holds the top node
+        chunk->next = pool_mgr->node_heap->next;
+        pool_mgr->node_heap->next = chunk;
+
+        //update capacity
+        pool_mgr->total_nodes += MEM_NODE_HEAP_CHUNK_SIZE;
+
+        // stack up the new nodes as unused
+        unsigned i = MEM_NODE_HEAP_CHUNK_SIZE;
+        while (i-- > 0)
+            _mem_push_unused_node(pool_mgr, &chunk->nodes[i]);
     }
 
-    // update metadata (num_gaps)
-    // zero out the element at position num_gaps!
-    pool_mgr->pool.num_gaps--;
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].size = 0;
-    pool_mgr->gap_ix[pool_mgr->pool.num_gaps].node = NULL;
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_resize_gap_ix(pool_mgr_pt pool_mgr) {
+
+    // check if necessary
+    if (((float) pool_mgr->gap_ix_size / pool_mgr->gap_ix_capacity) > MEM_GAP_IX_FILL_FACTOR) {
+
+        // reallocate w/ size expanded by expand factor
+        // (the tree links are slot numbers, so they survive the move)
+        gap_pt gap_ix = realloc(pool_mgr->gap_ix,
+                                sizeof(gap_t) * pool_mgr->gap_ix_capacity * MEM_GAP_IX_EXPAND_FACTOR);
+        if (gap_ix == NULL)
+            return ALLOC_FAIL;
+
+        //update capacity
+        pool_mgr->gap_ix = gap_ix;
+        pool_mgr->gap_ix_capacity *= MEM_GAP_IX_EXPAND_FACTOR;
+    }
 
     return ALLOC_OK;
 }
 
-static alloc_status _mem_sort_gap_ix(pool_mgr_pt pool_mgr) {
+static alloc_status _mem_resize_addr_ix(pool_mgr_pt pool_mgr) {
 
-    // the new entry is at the end, so "bubble it up"
-    // loop from num_gaps - 1 until but not including 0:
-    int i = pool_mgr->pool.num_gaps - 1;
-    while(i > 0) {
+    // check if necessary (with room for one more allocation)
+    if (((float) (pool_mgr->pool.num_allocs + 1) / pool_mgr->addr_ix_capacity) > MEM_ADDR_IX_FILL_FACTOR) {
 
-        int difference = (int) (pool_mgr->gap_ix[i].size - pool_mgr->gap_ix[i - 1].size);
+        // allocate w/ size expanded by expand factor, all slots empty
+        alloc_pt *old_ix = pool_mgr->addr_ix;
+        unsigned old_capacity = pool_mgr->addr_ix_capacity;
+        unsigned capacity = old_capacity * MEM_ADDR_IX_EXPAND_FACTOR;
 
-        // if the size of the current entry is less than the previous (u - 1)
-        if(difference < 0) {
+        alloc_pt *addr_ix = calloc(capacity, sizeof(alloc_pt));
+        if (addr_ix == NULL)
+            return ALLOC_FAIL;
 
-            // swap them (by copying) (remember to use a temporary variable)
-            gap_t t = pool_mgr->gap_ix[i - 1];
-            pool_mgr->gap_ix[i - 1] = pool_mgr->gap_ix[i];
-            pool_mgr->gap_ix[i] = t;
+        //update capacity
+        pool_mgr->addr_ix = addr_ix;
+        pool_mgr->addr_ix_capacity = capacity;
+
+        // rehash the entries into the new table
+        unsigned i = 0;
+        while (i < old_capacity) {
+            if (old_ix[i] != NULL)
+                _mem_add_to_addr_ix(pool_mgr, old_ix[i]);
+            i++;
         }
 
-        else if(difference == 0 && pool_mgr->gap_ix[i].node->alloc_record.mem < pool_mgr->gap_ix[i - 1].node->alloc_record.mem) {
+        free(old_ix);
+    }
 
-            //swap by alloc_record.mem
-            gap_t t = pool_mgr->gap_ix[i - 1];
-            pool_mgr->gap_ix[i - 1] = pool_mgr->gap_ix[i];
-            pool_mgr->gap_ix[i] = t;
-        }
+    return ALLOC_OK;
+}
 
-        i--;
+static node_pt _mem_find_gap(pool_mgr_pt pool_mgr, size_t size) {
+
+    node_pt node_alloc = NULL;
+
+    // if FIRST_FIT, then find the first sufficient gap in address order
+    // (the gap at the end of the pool, which isn't in the gap index, is
+    // the last one)
+    if (pool_mgr->pool.policy == FIRST_FIT) {
+        node_alloc = _mem_find_first_gap(pool_mgr, size);
+        if (node_alloc == NULL)
+            node_alloc = _mem_fit_wilderness(pool_mgr, size);
     }
 
+    // if BEST_FIT, then the gap at the end of the pool only wins if it's
+    // strictly smaller, since it has the highest address
+    else if (pool_mgr->pool.policy == BEST_FIT) {
+        node_alloc = _mem_find_best_gap(pool_mgr, size);
+        node_pt wilderness = _mem_fit_wilderness(pool_mgr, size);
+        if (node_alloc == NULL ||
+            (wilderness != NULL && wilderness->alloc_record.size < node_alloc->alloc_record.size))
+            node_alloc = wilderness;
+    }
 
-    return ALLOC_OK;
+    // if NEXT_FIT, then go on in address order from the end of the latest
+    // allocation, up to the end of the pool, and only wrap around to the
+    // start if nothing fits there
+    else if (pool_mgr->pool.policy == NEXT_FIT) {
+        node_alloc = _mem_find_next_gap(pool_mgr, pool_mgr->gap_ix_root, size, pool_mgr->next_fit_cursor);
+        if (node_alloc == NULL)
+            node_alloc = _mem_fit_wilderness(pool_mgr, size);
+        if (node_alloc == NULL)
+            node_alloc = _mem_find_first_gap(pool_mgr, size);
+    }
+
+    // if SEGREGATED_FIT, then look in the bins from the size's class up
+    else if (pool_mgr->pool.policy == SEGREGATED_FIT) {
+        node_alloc = _mem_find_binned_gap(pool_mgr, size);
+    }
+
+    // if TLSF, then take a gap of the first class that surely fits
+    else if (pool_mgr->pool.policy == TLSF) {
+        node_alloc = _mem_find_tlsf_gap(pool_mgr, size);
+    }
+
+    // if BUDDY, then look in the bins, which hold one block size each
+    else if (pool_mgr->pool.policy == BUDDY) {
+        node_alloc = _mem_find_binned_gap(pool_mgr, size);
+    }
+
+    return node_alloc;
 }
 
+static alloc_pt _mem_alloc_from_gap(pool_mgr_pt pool_mgr, node_pt node_alloc, size_t size) {
+
+    // the memory is no longer known to be zero once handed out
+    _mem_take_zero_ranges(pool_mgr, node_alloc->alloc_record.mem, size);
+
+    // bump the start of the gap at the end of the pool past the allocation,
+    // which takes a node of its own right in front of it, so the gap stays
+    // the same node, out of the gap index, and the gaps stay as many
+    // (unless the gap is the top node, or starts an arena, which stay first)
+    node_pt wilderness = pool_mgr->wilderness;
+    if (node_alloc == wilderness && wilderness->alloc_record.size > size &&
+        wilderness->prev != NULL && !wilderness->arena_start) {
+        node_pt node = _mem_pop_unused_node(pool_mgr);
+        if (node == NULL)
+            return NULL;
+
+        node->alloc_record.mem = wilderness->alloc_record.mem;
+        node->alloc_record.size = size;
+        node->used = 1;
+        node->allocated = 1;
+        wilderness->alloc_record.mem += size;
+        wilderness->alloc_record.size -= size;
+
+        //   update metadata (used_nodes, num_allocs, alloc_size)
+        //   update linked list (allocation right before the gap)
+        pool_mgr->used_nodes++;
+        pool_mgr->pool.num_allocs += 1;
+        pool_mgr->pool.alloc_size += size;
+        node->prev = wilderness->prev;
+        node->next = wilderness;
+        wilderness->prev->next = node;
+        wilderness->prev = node;
+        pool_mgr->next_fit_cursor = wilderness->alloc_record.mem;
+
+        _mem_add_to_addr_ix(pool_mgr, &node->alloc_record);
+        return &node->alloc_record;
+    }
+
+    // update metadata (num_allocs, alloc_size)
+    // calculate the size of the remaining gap, if any
+    // remove node from gap index
+    pool_mgr->pool.num_allocs += 1;
+    pool_mgr->pool.alloc_size += size;
+    size_t remaining_gap = node_alloc->alloc_record.size - size;
+    _mem_remove_gap(pool_mgr, node_alloc->alloc_record.size, node_alloc);
+
+
+
+
+    // convert gap_node to an allocation node of given size
+    node_alloc->alloc_record.size = size;
+    node_alloc->used = 1;
+    node_alloc->allocated = 1;
+    pool_mgr->next_fit_cursor = node_alloc->alloc_record.mem + size;
 
+    // make it findable by its address
+    _mem_add_to_addr_ix(pool_mgr, &node_alloc->alloc_record);
 
+
+    // adjust node heap:
+    if (remaining_gap > 0) {
+
+        //   if remaining gap, need a new node
+        //   take an unused one off the stack
+        node_pt nodes_unused = _mem_pop_unused_node(pool_mgr);
+
+        //   make sure one was found
+        if (nodes_unused == NULL)
+            return NULL;
+
+        //   initialize it to a gap node
+        nodes_unused->alloc_record.mem = node_alloc->alloc_record.mem + size;
+        nodes_unused->alloc_record.size = remaining_gap;
+        nodes_unused->used = 1;
+        nodes_unused->allocated = 0;
+        nodes_unused->next = NULL;
+        nodes_unused->prev = NULL;
+
+
+        //   update metadata (used_nodes)
+        //   update linked list (new node right after the node for allocation)
+        pool_mgr->used_nodes++;
+        nodes_unused->prev = node_alloc;
+        nodes_unused->next = node_alloc->next;
+        if (node_alloc->next != NULL)
+            node_alloc->next->prev = nodes_unused;
+        else
+            pool_mgr->last_node = nodes_unused;
+        node_alloc->next = nodes_unused;
+
+        //   add to gap index
+        //   check if successful
+        if (_mem_add_gap(pool_mgr, remaining_gap, nodes_unused) == ALLOC_FAIL)
+            return NULL;
+
+    }
+
+    // return allocation record by casting the node to (alloc_pt)
+    return (alloc_pt) node_alloc;
+}
+
+static node_pt _mem_find_aligned_gap(pool_mgr_pt pool_mgr, size_t size, size_t alignment) {
+
+    // walk the node list in address order, from the first node, to the
+    // first gap that fits once aligned
+    node_pt node = _mem_first_node(pool_mgr);
+    while (node != NULL) {
+        if (node->allocated == 0) {
+            size_t padding = _mem_align_padding(node->alloc_record.mem, alignment);
+            if (padding < node->alloc_record.size && node->alloc_record.size - padding >= size)
+                return node;
+        }
+        node = node->next;
+    }
+
+    return NULL;
+}
+
+static size_t _mem_align_padding(const char *mem, size_t alignment) {
+
+    // bytes from mem up to the next multiple of alignment (a power of 2)
+    return (size_t) (-(uintptr_t) mem & (alignment - 1));
+}
+
+static int _mem_is_live_alloc(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+
+    // the same checks mem_del_alloc makes, for each kind of pool
+    if (alloc == NULL)
+        return 0;
+
+    if (pool_mgr->flags & POOL_BOUNDARY_TAGS)
+        return _mem_find_tag(pool_mgr, alloc->mem) == (tag_pt) alloc;
+
+    if (pool_mgr->flags & POOL_COMPACT_NODES) {
+        unsigned pos = _mem_find_compact_seg(pool_mgr, alloc->mem);
+        return pos != MEM_COMPACT_NIL && pool_mgr->compact_records[pos] == alloc;
+    }
+
+    if (pool_mgr->pool.policy == SLAB)
+        return alloc->size != 0 && _mem_find_slab_slot(pool_mgr, alloc->mem) == (slab_slot_pt) alloc;
+
+    if (pool_mgr->pool.policy == BITMAP)
+        return _mem_find_in_addr_ix(pool_mgr, alloc->mem) == alloc;
+
+    node_pt node = (node_pt) alloc;
+    return node->used != 0 && node->allocated != 0 &&
+           _mem_find_in_addr_ix(pool_mgr, alloc->mem) == alloc;
+}
+
+static alloc_status _mem_grow_alloc(pool_mgr_pt pool_mgr, node_pt node, size_t size) {
+
+    // only the gap right after the allocation can take it
+    node_pt next = node->next;
+    size_t delta = size - node->alloc_record.size;
+    if (next == NULL || next->allocated != 0 || next->alloc_record.size < delta ||
+        next->arena_start)
+        return ALLOC_FAIL;
+
+    // take the gap out of the index while its key changes, and the memory
+    // out of the zero ranges
+    _mem_remove_gap(pool_mgr, next->alloc_record.size, next);
+    _mem_take_zero_ranges(pool_mgr, next->alloc_record.mem, delta);
+
+    // if all of it is used up, the gap node goes away
+    if (next->alloc_record.size == delta) {
+        node->next = next->next;
+        if (next->next != NULL)
+            next->next->prev = node;
+        else
+            pool_mgr->last_node = node;
+        _mem_push_unused_node(pool_mgr, next);
+        pool_mgr->used_nodes--;
+    }
+
+    // else the gap starts later
+    else {
+        next->alloc_record.mem += delta;
+        next->alloc_record.size -= delta;
+        _mem_add_gap(pool_mgr, next->alloc_record.size, next);
+    }
+
+    // update metadata (alloc_size)
+    node->alloc_record.size = size;
+    pool_mgr->pool.alloc_size += delta;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_shrink_alloc(pool_mgr_pt pool_mgr, node_pt node, size_t size) {
+
+    node_pt next = node->next;
+    size_t delta = node->alloc_record.size - size;
+    char *end = node->alloc_record.mem + size;
+
+    // if the next node is a gap, it just starts earlier
+    if (next != NULL && next->allocated == 0 && !next->arena_start) {
+        _mem_remove_gap(pool_mgr, next->alloc_record.size, next);
+        next->alloc_record.mem = end;
+        next->alloc_record.size += delta;
+        _mem_add_gap(pool_mgr, next->alloc_record.size, next);
+    }
+
+    // else the freed end of the allocation needs a gap node of its own
+    else {
+        node_pt gap = _mem_pop_unused_node(pool_mgr);
+        if (gap == NULL)
+            return ALLOC_FAIL;
+
+        gap->alloc_record.mem = end;
+        gap->alloc_record.size = delta;
+        gap->used = 1;
+        gap->allocated = 0;
+        gap->next_gap = NULL;
+        gap->prev_gap = NULL;
+
+        //   update metadata (used_nodes)
+        //   update linked list (gap right after the allocation)
+        pool_mgr->used_nodes++;
+        gap->prev = node;
+        gap->next = next;
+        if (next != NULL)
+            next->prev = gap;
+        else
+            pool_mgr->last_node = gap;
+        node->next = gap;
+
+        if (_mem_add_gap(pool_mgr, delta, gap) == ALLOC_FAIL)
+            return ALLOC_FAIL;
+    }
+
+    // update metadata (alloc_size)
+    node->alloc_record.size = size;
+    pool_mgr->pool.alloc_size -= delta;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_add_gap(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    // add the gap to whatever the policy of the pool searches:
+    //   FIRST_FIT, BEST_FIT, NEXT_FIT - the gap index tree, unless it's
+    //     the gap at the end of the pool, which is allocated from in place
+    //   SEGREGATED_FIT - the bin of its size class
+    //   BUDDY - the same, one block size per bin
+    //   TLSF - the bin of its (first, second level) size class
+    if (pool_mgr->pool.policy == FIRST_FIT || pool_mgr->pool.policy == BEST_FIT ||
+        pool_mgr->pool.policy == NEXT_FIT) {
+        if (node->next == NULL)
+            pool_mgr->wilderness = node;
+        else if (_mem_add_to_gap_ix(pool_mgr, size, node) == ALLOC_FAIL)
+            return ALLOC_FAIL;
+    }
+    else if (pool_mgr->pool.policy == SEGREGATED_FIT || pool_mgr->pool.policy == BUDDY) {
+        _mem_add_to_gap_bins(pool_mgr, size, node);
+    }
+    else if (pool_mgr->pool.policy == TLSF) {
+        _mem_add_to_tlsf_bins(pool_mgr, size, node);
+    }
+
+    // update metadata (num_gaps)
+    pool_mgr->pool.num_gaps++;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_remove_gap(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    // take the gap off whatever the policy of the pool searches
+    if (pool_mgr->pool.policy == FIRST_FIT || pool_mgr->pool.policy == BEST_FIT ||
+        pool_mgr->pool.policy == NEXT_FIT) {
+        if (node == pool_mgr->wilderness)
+            pool_mgr->wilderness = NULL;
+        else if (_mem_remove_from_gap_ix(pool_mgr, node) == ALLOC_FAIL)
+            return ALLOC_FAIL;
+    }
+    else if (pool_mgr->pool.policy == SEGREGATED_FIT || pool_mgr->pool.policy == BUDDY) {
+        _mem_remove_from_gap_bins(pool_mgr, size, node);
+    }
+    else if (pool_mgr->pool.policy == TLSF) {
+        _mem_remove_from_tlsf_bins(pool_mgr, size, node);
+    }
+
+    // update metadata (num_gaps)
+    pool_mgr->pool.num_gaps--;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_add_to_gap_ix(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+    // expand the gap index, if necessary (call the function)
+    if (_mem_resize_gap_ix(pool_mgr) == ALLOC_FAIL)
+        return ALLOC_FAIL;
+
+    // add the entry at the end of the array
+    gap_pt gap_ix = pool_mgr->gap_ix;
+    unsigned slot = pool_mgr->gap_ix_size++;
+    gap_ix[slot].size = size;
+    gap_ix[slot].node = node;
+    gap_ix[slot].left = MEM_GAP_IX_NIL;
+    gap_ix[slot].right = MEM_GAP_IX_NIL;
+    gap_ix[slot].height = 1;
+    gap_ix[slot].max_size = size;
+    node->gap_slot = slot;
+
+    // descend to its position in (size, address) or address order
+    unsigned parent = MEM_GAP_IX_NIL;
+    unsigned cur = pool_mgr->gap_ix_root;
+    int less = 0;
+    while (cur != MEM_GAP_IX_NIL) {
+        parent = cur;
+        less = _mem_gap_ix_less(pool_mgr, size, node->alloc_record.mem, &gap_ix[cur]);
+        cur = less ? gap_ix[cur].left : gap_ix[cur].right;
+    }
+
+    // link it in as a leaf
+    gap_ix[slot].parent = parent;
+    if (parent == MEM_GAP_IX_NIL)
+        pool_mgr->gap_ix_root = slot;
+    else if (less)
+        gap_ix[parent].left = slot;
+    else
+        gap_ix[parent].right = slot;
+
+    // restore the balance on the way back up
+    _mem_rebalance_gap_ix(pool_mgr, parent);
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_remove_from_gap_ix(pool_mgr_pt pool_mgr, node_pt node) {
+
+    gap_pt gap_ix = pool_mgr->gap_ix;
+
+    // the node knows its position in the gap index
+    unsigned slot = node->gap_slot;
+    if (slot >= pool_mgr->gap_ix_size || gap_ix[slot].node != node)
+        return ALLOC_FAIL;
+
+    // an entry with two children takes over the contents of its in-order
+    // successor, which has at most one child and is unlinked instead
+    if (gap_ix[slot].left != MEM_GAP_IX_NIL && gap_ix[slot].right != MEM_GAP_IX_NIL) {
+        unsigned succ = gap_ix[slot].right;
+        while (gap_ix[succ].left != MEM_GAP_IX_NIL)
+            succ = gap_ix[succ].left;
+
+        gap_ix[slot].size = gap_ix[succ].size;
+        gap_ix[slot].node = gap_ix[succ].node;
+        gap_ix[slot].node->gap_slot = slot;
+        slot = succ;
+    }
+
+    // splice the entry out and rebalance from its parent up
+    unsigned child = (gap_ix[slot].left != MEM_GAP_IX_NIL) ? gap_ix[slot].left : gap_ix[slot].right;
+    unsigned parent = gap_ix[slot].parent;
+    if (child != MEM_GAP_IX_NIL)
+        gap_ix[child].parent = parent;
+    _mem_relink_gap_ix(pool_mgr, parent, slot, child);
+    _mem_rebalance_gap_ix(pool_mgr, parent);
+
+    // pull the last entry into the vacated slot to keep the array packed
+    unsigned last = --pool_mgr->gap_ix_size;
+    if (slot != last) {
+        gap_ix[slot] = gap_ix[last];
+        gap_ix[slot].node->gap_slot = slot;
+        _mem_relink_gap_ix(pool_mgr, gap_ix[slot].parent, last, slot);
+        if (gap_ix[slot].left != MEM_GAP_IX_NIL)
+            gap_ix[gap_ix[slot].left].parent = slot;
+        if (gap_ix[slot].right != MEM_GAP_IX_NIL)
+            gap_ix[gap_ix[slot].right].parent = slot;
+    }
+
+    // zero out the element at position gap_ix_size!
+    gap_ix[last].size = 0;
+    gap_ix[last].node = NULL;
+
+    return ALLOC_OK;
+}
+
+static node_pt _mem_find_best_gap(pool_mgr_pt pool_mgr, size_t size) {
+
+    // the leftmost entry of sufficient size is the smallest fitting gap,
+    // and among gaps of equal size the one at the lowest address
+    node_pt best = NULL;
+    unsigned slot = pool_mgr->gap_ix_root;
+    while (slot != MEM_GAP_IX_NIL) {
+        if (pool_mgr->gap_ix[slot].size >= size) {
+            best = pool_mgr->gap_ix[slot].node;
+            slot = pool_mgr->gap_ix[slot].left;
+        }
+        else {
+            slot = pool_mgr->gap_ix[slot].right;
+        }
+    }
+
+    return best;
+}
+
+static node_pt _mem_find_first_gap(pool_mgr_pt pool_mgr, size_t size) {
+
+    // in address order, the first fitting gap is in the left subtree if
+    // any gap there fits, else it's this one if it fits, else it's in the
+    // right subtree, and the largest gap of each subtree tells which
+    gap_pt gap_ix = pool_mgr->gap_ix;
+    unsigned slot = pool_mgr->gap_ix_root;
+    if (slot == MEM_GAP_IX_NIL || gap_ix[slot].max_size < size)
+        return NULL;
+
+    while (1) {
+        unsigned left = gap_ix[slot].left;
+        if (left != MEM_GAP_IX_NIL && gap_ix[left].max_size >= size)
+            slot = left;
+        else if (gap_ix[slot].size >= size)
+            return gap_ix[slot].node;
+        else
+            slot = gap_ix[slot].right;
+    }
+}
+
+static node_pt _mem_find_next_gap(pool_mgr_pt pool_mgr, unsigned slot, size_t size, const char *cursor) {
+
+    // find the first fitting gap in address order that ends past the
+    // cursor, which may be the gap the cursor is in
+    gap_pt gap_ix = pool_mgr->gap_ix;
+    if (slot == MEM_GAP_IX_NIL || gap_ix[slot].max_size < size)
+        return NULL;
+
+    // if this gap ends before the cursor, so do all of the left subtree
+    gap_pt gap = &gap_ix[slot];
+    if (gap->node->alloc_record.mem + gap->size <= cursor)
+        return _mem_find_next_gap(pool_mgr, gap->right, size, cursor);
+
+    // otherwise, the left subtree may still hold one that doesn't, and all
+    // of the right subtree does
+    node_pt node = _mem_find_next_gap(pool_mgr, gap->left, size, cursor);
+    if (node != NULL)
+        return node;
+    if (gap->size >= size)
+        return gap->node;
+    return _mem_find_next_gap(pool_mgr, gap->right, size, cursor);
+}
+
+static node_pt _mem_fit_wilderness(pool_mgr_pt pool_mgr, size_t size) {
+
+    // the gap at the end of the pool, if there is one and it fits
+    node_pt node = pool_mgr->wilderness;
+    if (node == NULL || node->alloc_record.size < size)
+        return NULL;
+
+    return node;
+}
+
+static void _mem_add_to_gap_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    // push the gap on the list of its size class
+    unsigned bin = _mem_log2(size);
+    _mem_link_gap(&pool_mgr->gap_bins[bin], node);
+    pool_mgr->gap_bin_map |= 1ull << bin;
+}
+
+static void _mem_remove_from_gap_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    unsigned bin = _mem_log2(size);
+    _mem_unlink_gap(&pool_mgr->gap_bins[bin], node);
+    if (pool_mgr->gap_bins[bin] == NULL)
+        pool_mgr->gap_bin_map &= ~(1ull << bin);
+}
+
+static node_pt _mem_find_binned_gap(pool_mgr_pt pool_mgr, size_t size) {
+
+    // the bin of the size's own class may also hold smaller gaps
+    unsigned bin = _mem_log2(size);
+    node_pt node = pool_mgr->gap_bins[bin];
+    while (node != NULL && node->alloc_record.size < size)
+        node = node->next_gap;
+
+    if (node != NULL)
+        return node;
+
+    // any gap in a higher class fits, so take the first of the lowest
+    // non-empty one (2ull << 63 wraps to 0, leaving no higher bins)
+    unsigned long long higher = pool_mgr->gap_bin_map & ~((2ull << bin) - 1);
+    if (higher == 0)
+        return NULL;
+
+    return pool_mgr->gap_bins[_mem_lowest_bit(higher)];
+}
+
+static unsigned _mem_tlsf_bin(size_t size) {
+
+    // the first level is the power of 2 of the size, split linearly into
+    // MEM_TLSF_SL_COUNT second-level classes by the bits that follow the
+    // highest one; sizes below MEM_TLSF_SL_COUNT each get a class of
+    // their own in first level 0
+    if (size < MEM_TLSF_SL_COUNT)
+        return (unsigned) size;
+
+    unsigned log = _mem_log2(size);
+    unsigned fl = log - MEM_TLSF_SL_LOG + 1;
+    unsigned sl = (unsigned) (size >> (log - MEM_TLSF_SL_LOG)) - MEM_TLSF_SL_COUNT;
+
+    return fl * MEM_TLSF_SL_COUNT + sl;
+}
+
+static void _mem_add_to_tlsf_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    // push the gap on the list of the class its size falls into
+    unsigned bin = _mem_tlsf_bin(size);
+    unsigned fl = bin / MEM_TLSF_SL_COUNT;
+    _mem_link_gap(&pool_mgr->gap_bins[bin], node);
+    pool_mgr->gap_bin_sl_map[fl] |= 1u << (bin % MEM_TLSF_SL_COUNT);
+    pool_mgr->gap_bin_map |= 1ull << fl;
+}
+
+static void _mem_remove_from_tlsf_bins(pool_mgr_pt pool_mgr, size_t size, node_pt node) {
+
+    unsigned bin = _mem_tlsf_bin(size);
+    unsigned fl = bin / MEM_TLSF_SL_COUNT;
+    _mem_unlink_gap(&pool_mgr->gap_bins[bin], node);
+    if (pool_mgr->gap_bins[bin] == NULL) {
+        pool_mgr->gap_bin_sl_map[fl] &= ~(1u << (bin % MEM_TLSF_SL_COUNT));
+        if (pool_mgr->gap_bin_sl_map[fl] == 0)
+            pool_mgr->gap_bin_map &= ~(1ull << fl);
+    }
+}
+
+static node_pt _mem_find_tlsf_gap(pool_mgr_pt pool_mgr, size_t size) {
+
+    // nothing bigger than the pool fits (and rounding can't overflow)
+    if (size > pool_mgr->pool.total_size)
+        return NULL;
+
+    // round the size up to the next class boundary, so that any gap
+    // of the class found fits, and its list needs no searching
+    if (size >= MEM_TLSF_SL_COUNT)
+        size += ((size_t) 1 << (_mem_log2(size) - MEM_TLSF_SL_LOG)) - 1;
+
+    unsigned bin = _mem_tlsf_bin(size);
+    unsigned fl = bin / MEM_TLSF_SL_COUNT;
+
+    // a non-empty class of the same first level, at or above the size's,
+    // or else the lowest one of the next non-empty first level
+    unsigned sl_map = pool_mgr->gap_bin_sl_map[fl] & (~0u << (bin % MEM_TLSF_SL_COUNT));
+    if (sl_map == 0) {
+        unsigned long long fl_map = pool_mgr->gap_bin_map & (~0ull << (fl + 1));
+        if (fl_map == 0)
+            return NULL;
+
+        fl = _mem_lowest_bit(fl_map);
+        sl_map = pool_mgr->gap_bin_sl_map[fl];
+    }
+
+    return pool_mgr->gap_bins[fl * MEM_TLSF_SL_COUNT + _mem_lowest_bit(sl_map)];
+}
+
+static size_t _mem_buddy_size(size_t size) {
+
+    // the smallest power of 2 that holds the size, 0 if none does
+    if (size <= 1)
+        return 1;
+    if (size > ((size_t) 1 << 63))
+        return 0;
+
+    return (size_t) 1 << (_mem_log2(size - 1) + 1);
+}
+
+static alloc_status _mem_init_buddy_blocks(pool_mgr_pt pool_mgr) {
+
+    // cut the pool into blocks of the powers of 2 its size is made of,
+    // largest first, so that each block starts at a multiple of its size
+    node_pt node = pool_mgr->node_heap->nodes;
+    size_t rest = pool_mgr->pool.total_size;
+
+    while (1) {
+        size_t block = (size_t) 1 << _mem_log2(rest);
+
+        node->alloc_record.size = block;
+        _mem_add_gap(pool_mgr, block, node);
+
+        rest -= block;
+        if (rest == 0)
+            return ALLOC_OK;
+
+        //   the rest of the pool needs another node
+        if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL)
+            return ALLOC_FAIL;
+
+        node_pt next = _mem_pop_unused_node(pool_mgr);
+        next->alloc_record.mem = node->alloc_record.mem + block;
+        next->used = 1;
+        next->allocated = 0;
+        next->next = NULL;
+        next->prev = node;
+        node->next = next;
+        pool_mgr->last_node = next;
+        pool_mgr->used_nodes++;
+
+        node = next;
+    }
+}
+
+static node_pt _mem_split_buddy(pool_mgr_pt pool_mgr, node_pt node, size_t size) {
+
+    // take the block out of its bin while its size changes
+    _mem_remove_gap(pool_mgr, node->alloc_record.size, node);
+
+    // halve it until it's the size, the upper half a gap each time
+    while (node->alloc_record.size > size) {
+
+        //   on error, put the block back as it is now
+        if (_mem_resize_node_heap(pool_mgr) == ALLOC_FAIL) {
+            _mem_add_gap(pool_mgr, node->alloc_record.size, node);
+            return NULL;
+        }
+
+        size_t half = node->alloc_record.size / 2;
+        node_pt upper = _mem_pop_unused_node(pool_mgr);
+        upper->alloc_record.mem = node->alloc_record.mem + half;
+        upper->alloc_record.size = half;
+        upper->used = 1;
+        upper->allocated = 0;
+        upper->prev = node;
+        upper->next = node->next;
+        if (node->next != NULL)
+            node->next->prev = upper;
+        else
+            pool_mgr->last_node = upper;
+        node->next = upper;
+        node->alloc_record.size = half;
+        pool_mgr->used_nodes++;
+
+        _mem_add_gap(pool_mgr, half, upper);
+    }
+
+    // back in its bin, as a gap of exactly the size
+    _mem_add_gap(pool_mgr, size, node);
+
+    return node;
+}
+
+static void _mem_merge_buddy(pool_mgr_pt pool_mgr, node_pt node) {
+
+    size_t size = node->alloc_record.size;
+
+    // the buddy of a block is the other half of the block of twice its
+    // size, so its offset differs just in the size bit; the two merge if
+    // that block lies inside the pool, and the buddy is a whole gap, i.e.
+    // the neighbour on its side is a gap of the same size
+    while (size <= pool_mgr->pool.total_size / 2) {
+        size_t offset = (size_t) (node->alloc_record.mem - pool_mgr->pool.mem);
+        size_t buddy_offset = offset ^ size;
+
+        if ((offset & ~(2 * size - 1)) + 2 * size > pool_mgr->pool.total_size)
+            break;
+
+        node_pt buddy = (buddy_offset > offset) ? node->next : node->prev;
+        if (buddy == NULL || buddy->allocated || buddy->alloc_record.size != size)
+            break;
+
+        //   the lower block absorbs the upper one
+        _mem_remove_gap(pool_mgr, size, buddy);
+
+        node_pt lower = (buddy_offset > offset) ? node : buddy;
+        node_pt upper = (buddy_offset > offset) ? buddy : node;
+        lower->alloc_record.size = 2 * size;
+        lower->next = upper->next;
+        if (upper->next != NULL)
+            upper->next->prev = lower;
+        else
+            pool_mgr->last_node = lower;
+        _mem_push_unused_node(pool_mgr, upper);
+        pool_mgr->used_nodes--;
+
+        node = lower;
+        size *= 2;
+    }
+
+    _mem_add_gap(pool_mgr, size, node);
+}
+
+static unsigned _mem_log2(size_t size) {
+
+    // position of the highest set bit (size > 0)
+    return 63 - (unsigned) __builtin_clzll((unsigned long long) size);
+}
+
+static unsigned _mem_lowest_bit(unsigned long long map) {
+
+    // position of the lowest set bit (map > 0)
+    return (unsigned) __builtin_ctzll(map);
+}
+
+static void _mem_link_gap(node_pt *list, node_pt node) {
+
+    // insert the node at the head of the list
+    node->prev_gap = NULL;
+    node->next_gap = *list;
+    *list = node;
+
+    if (node->next_gap != NULL)
+        node->next_gap->prev_gap = node;
+}
+
+static void _mem_unlink_gap(node_pt *list, node_pt node) {
+
+    if (node->prev_gap == NULL)
+        *list = node->next_gap;
+    else
+        node->prev_gap->next_gap = node->next_gap;
+
+    if (node->next_gap != NULL)
+        node->next_gap->prev_gap = node->prev_gap;
+
+    node->next_gap = NULL;
+    node->prev_gap = NULL;
+}
+
+static void _mem_push_unused_node(pool_mgr_pt pool_mgr, node_pt node) {
+
+    // clear the node and put it on top of the unused stack
+    node->alloc_record.size = 0;
+    node->alloc_record.mem = NULL;
+    node->used = 0;
+    node->allocated = 0;
+    node->arena_start = 0;
+    node->prev = NULL;
+    node->next_gap = NULL;
+    node->prev_gap = NULL;
+
+    node->next = pool_mgr->unused_nodes;
+    pool_mgr->unused_nodes = node;
+}
+
+static node_pt _mem_pop_unused_node(pool_mgr_pt pool_mgr) {
+
+    node_pt node = pool_mgr->unused_nodes;
+    if (node != NULL) {
+        pool_mgr->unused_nodes = node->next;
+        node->next = NULL;
+    }
+
+    return node;
+}
+
+static unsigned _mem_addr_ix_hash(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // multiplicative (Fibonacci) hash of the offset into the pool
+    // (or into another arena, in a growable pool)
+    unsigned long long offset = (unsigned long long) ((uintptr_t) mem - (uintptr_t) pool_mgr->pool.mem);
+
+    return (unsigned) ((offset * 0x9E3779B97F4A7C15ull) >> 32) & (pool_mgr->addr_ix_capacity - 1);
+}
+
+static void _mem_add_to_addr_ix(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+
+    // linear probing from the home slot to the first empty one
+    // (the caller has made sure there is room)
+    unsigned mask = pool_mgr->addr_ix_capacity - 1;
+    unsigned i = _mem_addr_ix_hash(pool_mgr, alloc->mem);
+    while (pool_mgr->addr_ix[i] != NULL)
+        i = (i + 1) & mask;
+
+    pool_mgr->addr_ix[i] = alloc;
+}
+
+static void _mem_remove_from_addr_ix(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+
+    unsigned mask = pool_mgr->addr_ix_capacity - 1;
+
+    // find the entry
+    unsigned hole = _mem_addr_ix_hash(pool_mgr, alloc->mem);
+    while (pool_mgr->addr_ix[hole] != alloc) {
+        if (pool_mgr->addr_ix[hole] == NULL)
+            return;
+        hole = (hole + 1) & mask;
+    }
+
+    // shift back the entries of the run that follows, unless that would
+    // move them in front of their home slot, so no tombstones are needed
+    unsigned i = hole;
+    while (1) {
+        i = (i + 1) & mask;
+        if (pool_mgr->addr_ix[i] == NULL)
+            break;
+
+        unsigned home = _mem_addr_ix_hash(pool_mgr, pool_mgr->addr_ix[i]->mem);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            pool_mgr->addr_ix[hole] = pool_mgr->addr_ix[i];
+            hole = i;
+        }
+    }
+
+    pool_mgr->addr_ix[hole] = NULL;
+}
+
+static alloc_pt _mem_find_in_addr_ix(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // only addresses within the pool can be in the index
+    // (a growable pool has its arenas all over, so it just probes)
+    if (!(pool_mgr->flags & POOL_GROWABLE) &&
+        ((uintptr_t) mem < (uintptr_t) pool_mgr->pool.mem ||
+         (uintptr_t) mem >= (uintptr_t) pool_mgr->pool.mem + pool_mgr->pool.total_size))
+        return NULL;
+
+    unsigned mask = pool_mgr->addr_ix_capacity - 1;
+    unsigned i = _mem_addr_ix_hash(pool_mgr, mem);
+    while (pool_mgr->addr_ix[i] != NULL) {
+        if (pool_mgr->addr_ix[i]->mem == mem)
+            return pool_mgr->addr_ix[i];
+        i = (i + 1) & mask;
+    }
+
+    return NULL;
+}
+
+static int _mem_gap_ix_less(pool_mgr_pt pool_mgr, size_t size, const char *mem, const gap_t *gap) {
+
+    // order by address in a FIRST_FIT or NEXT_FIT pool
+    if (pool_mgr->pool.policy == FIRST_FIT || pool_mgr->pool.policy == NEXT_FIT)
+        return mem < gap->node->alloc_record.mem;
+
+    // otherwise order by size, break ties by address
+    return size < gap->size ||
+           (size == gap->size && mem < gap->node->alloc_record.mem);
+}
+
+static unsigned _mem_gap_ix_height(pool_mgr_pt pool_mgr, unsigned slot) {
+    return (slot == MEM_GAP_IX_NIL) ? 0 : pool_mgr->gap_ix[slot].height;
+}
+
+static void _mem_update_gap_ix(pool_mgr_pt pool_mgr, unsigned slot) {
+    gap_pt gap = &pool_mgr->gap_ix[slot];
+    unsigned left = _mem_gap_ix_height(pool_mgr, gap->left);
+    unsigned right = _mem_gap_ix_height(pool_mgr, gap->right);
+
+    gap->height = 1 + ((left > right) ? left : right);
+
+    // the largest gap of the subtree, for the FIRST_FIT and NEXT_FIT descents
+    gap->max_size = gap->size;
+    if (gap->left != MEM_GAP_IX_NIL && pool_mgr->gap_ix[gap->left].max_size > gap->max_size)
+        gap->max_size = pool_mgr->gap_ix[gap->left].max_size;
+    if (gap->right != MEM_GAP_IX_NIL && pool_mgr->gap_ix[gap->right].max_size > gap->max_size)
+        gap->max_size = pool_mgr->gap_ix[gap->right].max_size;
+}
+
+static int _mem_check_gap_ix(pool_mgr_pt pool_mgr, unsigned slot, unsigned parent,
+                             unsigned *prev, unsigned *count) {
+    if (slot == MEM_GAP_IX_NIL)
+        return 1;
+
+    // the entry is in the array and linked back to its parent
+    gap_pt gap = &pool_mgr->gap_ix[slot];
+    if (slot >= pool_mgr->gap_ix_size || gap->parent != parent)
+        return 0;
+
+    // in order, each entry is after the one before it
+    if (!_mem_check_gap_ix(pool_mgr, gap->left, slot, prev, count))
+        return 0;
+    if (*prev != MEM_GAP_IX_NIL &&
+        !_mem_gap_ix_less(pool_mgr, pool_mgr->gap_ix[*prev].size,
+                          pool_mgr->gap_ix[*prev].node->alloc_record.mem, gap))
+        return 0;
+    *prev = slot;
+    (*count)++;
+    if (!_mem_check_gap_ix(pool_mgr, gap->right, slot, prev, count))
+        return 0;
+
+    // the subtrees are balanced, and the height and max_size are up to date
+    unsigned left = _mem_gap_ix_height(pool_mgr, gap->left);
+    unsigned right = _mem_gap_ix_height(pool_mgr, gap->right);
+    size_t max_size = gap->max_size;
+    unsigned height = gap->height;
+    _mem_update_gap_ix(pool_mgr, slot);
+
+    return left <= right + 1 && right <= left + 1 &&
+           gap->height == height && gap->max_size == max_size;
+}
+
+static void _mem_relink_gap_ix(pool_mgr_pt pool_mgr, unsigned parent, unsigned old, unsigned new) {
+
+    // point the parent (or the root) at the new child in place of the old
+    if (parent == MEM_GAP_IX_NIL)
+        pool_mgr->gap_ix_root = new;
+    else if (pool_mgr->gap_ix[parent].left == old)
+        pool_mgr->gap_ix[parent].left = new;
+    else
+        pool_mgr->gap_ix[parent].right = new;
+}
+
+static unsigned _mem_rotate_gap_ix(pool_mgr_pt pool_mgr, unsigned slot, int left) {
+
+    // rotate the subtree at slot, returning the slot of its new top
+    gap_pt gap_ix = pool_mgr->gap_ix;
+    unsigned top, inner;
+
+    if (left) {
+        top = gap_ix[slot].right;
+        inner = gap_ix[top].left;
+        gap_ix[slot].right = inner;
+        gap_ix[top].left = slot;
+    }
+    else {
+        top = gap_ix[slot].left;
+        inner = gap_ix[top].right;
+        gap_ix[slot].left = inner;
+        gap_ix[top].right = slot;
+    }
+
+    if (inner != MEM_GAP_IX_NIL)
+        gap_ix[inner].parent = slot;
+    gap_ix[top].parent = gap_ix[slot].parent;
+    _mem_relink_gap_ix(pool_mgr, gap_ix[slot].parent, slot, top);
+    gap_ix[slot].parent = top;
+
+    _mem_update_gap_ix(pool_mgr, slot);
+    _mem_update_gap_ix(pool_mgr, top);
+
+    return top;
+}
+
+static void _mem_rebalance_gap_ix(pool_mgr_pt pool_mgr, unsigned slot) {
+
+    gap_pt gap_ix = pool_mgr->gap_ix;
+
+    // walk up to the root, fixing heights and rotating where the
+    // subtrees differ in height by more than one
+    while (slot != MEM_GAP_IX_NIL) {
+        _mem_update_gap_ix(pool_mgr, slot);
+
+        unsigned left = gap_ix[slot].left;
+        unsigned right = gap_ix[slot].right;
+        int balance = (int) _mem_gap_ix_height(pool_mgr, left) -
+                      (int) _mem_gap_ix_height(pool_mgr, right);
+
+        if (balance > 1) {
+            if (_mem_gap_ix_height(pool_mgr, gap_ix[left].left) <
+                _mem_gap_ix_height(pool_mgr, gap_ix[left].right))
+                _mem_rotate_gap_ix(pool_mgr, left, 1);
+            slot = _mem_rotate_gap_ix(pool_mgr, slot, 0);
+        }
+        else if (balance < -1) {
+            if (_mem_gap_ix_height(pool_mgr, gap_ix[right].right) <
+                _mem_gap_ix_height(pool_mgr, gap_ix[right].left))
+                _mem_rotate_gap_ix(pool_mgr, right, 0);
+            slot = _mem_rotate_gap_ix(pool_mgr, slot, 1);
+        }
+
+        slot = gap_ix[slot].parent;
+    }
+}
+
+static void _mem_init_tags(pool_mgr_pt pool_mgr) {
+
+    // the whole pool is one gap
+    tag_pt tag = (tag_pt) pool_mgr->pool.mem;
+    _mem_set_tags(tag, pool_mgr->pool.total_size, pool_mgr->pool.total_size - MEM_TAG_OVERHEAD, NULL);
+
+    pool_mgr->tag_gaps = NULL;
+    _mem_link_tag_gap(pool_mgr, tag);
+    pool_mgr->pool.num_gaps = 1;
+}
+
+static void _mem_set_tags(tag_pt tag, size_t length, size_t size, char *mem) {
+
+    // header and footer both get the length, flagged for an allocation
+    size_t flagged = length | (mem != NULL);
+    tag->alloc_record.size = size;
+    tag->alloc_record.mem = mem;
+    tag->length = flagged;
+    *(size_t *) ((char *) tag + length - sizeof(size_t)) = flagged;
+}
+
+static tag_gap_pt _mem_tag_gap_links(tag_pt tag) {
+
+    // right after the header, where an allocation's memory would be
+    return (tag_gap_pt) (tag + 1);
+}
+
+static void _mem_link_tag_gap(pool_mgr_pt pool_mgr, tag_pt tag) {
+
+    // insert the gap at the head of the list
+    tag_gap_pt links = _mem_tag_gap_links(tag);
+    links->prev_gap = NULL;
+    links->next_gap = pool_mgr->tag_gaps;
+    if (links->next_gap != NULL)
+        _mem_tag_gap_links(links->next_gap)->prev_gap = tag;
+    pool_mgr->tag_gaps = tag;
+}
+
+static void _mem_unlink_tag_gap(pool_mgr_pt pool_mgr, tag_pt tag) {
+
+    tag_gap_pt links = _mem_tag_gap_links(tag);
+    if (links->prev_gap == NULL)
+        pool_mgr->tag_gaps = links->next_gap;
+    else
+        _mem_tag_gap_links(links->prev_gap)->next_gap = links->next_gap;
+
+    if (links->next_gap != NULL)
+        _mem_tag_gap_links(links->next_gap)->prev_gap = links->prev_gap;
+}
+
+static alloc_pt _mem_new_tagged_alloc(pool_mgr_pt pool_mgr, size_t size) {
+
+    // the segment takes the tags and the size, rounded up to keep the
+    // next header aligned, and has to be able to hold a gap once freed
+    if (size > pool_mgr->pool.total_size)
+        return NULL;
+    size_t length = MEM_TAG_OVERHEAD + (size + MEM_TAG_ALIGN - 1) / MEM_TAG_ALIGN * MEM_TAG_ALIGN;
+    if (length < MEM_TAG_MIN_LENGTH)
+        length = MEM_TAG_MIN_LENGTH;
+
+    // find the lowest-address (FIRST_FIT) or smallest (BEST_FIT) gap that
+    // fits; the gap list is in no particular order, so look at them all
+    tag_pt gap = NULL;
+    tag_pt tag = pool_mgr->tag_gaps;
+    while (tag != NULL) {
+        if (tag->length >= length &&
+            (gap == NULL ||
+             (pool_mgr->pool.policy == FIRST_FIT && tag < gap) ||
+             (pool_mgr->pool.policy == BEST_FIT &&
+              (tag->length < gap->length || (tag->length == gap->length && tag < gap))))) {
+            gap = tag;
+        }
+        tag = _mem_tag_gap_links(tag)->next_gap;
+    }
+
+    if (gap == NULL)
+        return NULL;
+
+    // split off the rest as a gap of its own, if it's big enough to be one,
+    // taking the place of the old gap on the list
+    size_t rest = gap->length - length;
+    if (rest >= MEM_TAG_MIN_LENGTH) {
+        tag_pt rest_gap = (tag_pt) ((char *) gap + length);
+        _mem_set_tags(rest_gap, rest, rest - MEM_TAG_OVERHEAD, NULL);
+
+        tag_gap_pt links = _mem_tag_gap_links(gap);
+        tag_gap_pt rest_links = _mem_tag_gap_links(rest_gap);
+        rest_links->next_gap = links->next_gap;
+        rest_links->prev_gap = links->prev_gap;
+        if (links->next_gap != NULL)
+            _mem_tag_gap_links(links->next_gap)->prev_gap = rest_gap;
+        if (links->prev_gap == NULL)
+            pool_mgr->tag_gaps = rest_gap;
+        else
+            _mem_tag_gap_links(links->prev_gap)->next_gap = rest_gap;
+    }
+    else {
+        // otherwise the allocation gets the whole gap
+        length = gap->length;
+        _mem_unlink_tag_gap(pool_mgr, gap);
+        pool_mgr->pool.num_gaps--;
+    }
+
+    // update metadata (num_allocs, alloc_size)
+    _mem_set_tags(gap, length, size, (char *) (gap + 1));
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += size;
+
+    return &gap->alloc_record;
+}
+
+static tag_pt _mem_find_tag(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // the header is right in front of the memory, so the memory has to
+    // be far enough into the pool, and aligned like a header
+    char *start = pool_mgr->pool.mem;
+    char *end = start + pool_mgr->pool.total_size;
+    if ((uintptr_t) mem < (uintptr_t) start + sizeof(tag_t) ||
+        (uintptr_t) mem >= (uintptr_t) end ||
+        ((uintptr_t) mem - (uintptr_t) start) % MEM_TAG_ALIGN != 0)
+        return NULL;
+
+    // and it has to be a live allocation's, with tags that agree
+    tag_pt tag = (tag_pt) mem - 1;
+    size_t length = tag->length & ~(size_t) 1;
+    if (tag->alloc_record.mem != mem || (tag->length & 1) == 0 ||
+        length > (size_t) (end - (char *) tag) ||
+        *(size_t *) ((char *) tag + length - sizeof(size_t)) != tag->length)
+        return NULL;
+
+    return tag;
+}
+
+static void _mem_del_tagged_alloc(pool_mgr_pt pool_mgr, tag_pt tag) {
+
+    char *start = pool_mgr->pool.mem;
+    char *end = start + pool_mgr->pool.total_size;
+    size_t length = tag->length & ~(size_t) 1;
+
+    // update metadata (num_allocs, alloc_size)
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= tag->alloc_record.size;
+
+    // the header may end up inside a bigger gap, so make sure it no
+    // longer passes for an allocation's
+    tag->alloc_record.mem = NULL;
+
+    // if the next segment, right after this one, is a gap, merge it in
+    tag_pt next = (tag_pt) ((char *) tag + length);
+    if ((char *) next < end && (next->length & 1) == 0) {
+        _mem_unlink_tag_gap(pool_mgr, next);
+        pool_mgr->pool.num_gaps--;
+        length += next->length;
+    }
+
+    // if the previous segment is a gap, as its footer right before this
+    // one tells, merge into it
+    if ((char *) tag > start) {
+        size_t prev_length = *((size_t *) tag - 1);
+        if ((prev_length & 1) == 0) {
+            tag = (tag_pt) ((char *) tag - prev_length);
+            _mem_unlink_tag_gap(pool_mgr, tag);
+            pool_mgr->pool.num_gaps--;
+            length += prev_length;
+        }
+    }
+
+    // tag the result as a gap and put it on the list
+    _mem_set_tags(tag, length, length - MEM_TAG_OVERHEAD, NULL);
+    _mem_link_tag_gap(pool_mgr, tag);
+    pool_mgr->pool.num_gaps++;
+}
+
+static void _mem_init_slab_slots(pool_mgr_pt pool_mgr) {
+
+    // every slot is free, and listed in address order
+    size_t object_size = pool_mgr->slab_object_size;
+    slab_slot_pt slots = pool_mgr->slab_slots;
+    unsigned i = pool_mgr->num_slab_slots;
+    pool_mgr->slab_free = NULL;
+    while (i-- > 0) {
+        slots[i].alloc_record.size = 0;
+        slots[i].alloc_record.mem = pool_mgr->pool.mem + i * object_size;
+        slots[i].next_free = pool_mgr->slab_free;
+        pool_mgr->slab_free = &slots[i];
+    }
+
+    // each free slot is a gap, and so is the tail, if any
+    pool_mgr->pool.num_gaps = pool_mgr->num_slab_slots +
+                              (pool_mgr->pool.total_size % object_size != 0);
+}
+
+static alloc_pt _mem_new_slab_alloc(pool_mgr_pt pool_mgr, size_t size) {
+
+    // the object has to fit in a slot, and a slot has to be free
+    slab_slot_pt slot = pool_mgr->slab_free;
+    if (size > pool_mgr->slab_object_size || slot == NULL)
+        return NULL;
+
+    // take it off the free list
+    pool_mgr->slab_free = slot->next_free;
+    slot->next_free = NULL;
+
+    // the allocation takes the whole slot, but records the size asked
+    // for, which is never 0, so 0 still marks a free slot
+    // update metadata (num_allocs, alloc_size, num_gaps)
+    slot->alloc_record.size = size;
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += size;
+    pool_mgr->pool.num_gaps--;
+
+    return &slot->alloc_record;
+}
+
+static slab_slot_pt _mem_find_slab_slot(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // the memory has to be the start of a slot
+    uintptr_t start = (uintptr_t) pool_mgr->pool.mem;
+    if ((uintptr_t) mem < start ||
+        ((uintptr_t) mem - start) % pool_mgr->slab_object_size != 0)
+        return NULL;
+
+    size_t i = ((uintptr_t) mem - start) / pool_mgr->slab_object_size;
+    if (i >= pool_mgr->num_slab_slots)
+        return NULL;
+
+    // and it has to be allocated
+    slab_slot_pt slot = &pool_mgr->slab_slots[i];
+    if (slot->alloc_record.size == 0)
+        return NULL;
+
+    return slot;
+}
+
+static void _mem_del_slab_alloc(pool_mgr_pt pool_mgr, slab_slot_pt slot) {
+
+    // update metadata (num_allocs, alloc_size, num_gaps)
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= slot->alloc_record.size;
+    pool_mgr->pool.num_gaps++;
+
+    // free the slot and put it back on the free list, which hands it out
+    // again first, while it's likely still in the cache
+    slot->alloc_record.size = 0;
+    slot->next_free = pool_mgr->slab_free;
+    pool_mgr->slab_free = slot;
+}
+
+static alloc_status _mem_resize_compact_segs(pool_mgr_pt pool_mgr) {
+
+    // check if necessary (no room for one more segment)
+    if (pool_mgr->num_compact_segs < pool_mgr->compact_capacity)
+        return ALLOC_OK;
+
+    // reallocate w/ size expanded by expand factor
+    // (each array on its own, so that a failure leaves them all usable)
+    unsigned capacity = (pool_mgr->compact_capacity == 0) ?
+                        MEM_COMPACT_INIT_CAPACITY :
+                        pool_mgr->compact_capacity * MEM_COMPACT_EXPAND_FACTOR;
+    if (capacity <= pool_mgr->compact_capacity)
+        return ALLOC_FAIL;
+
+    uint32_t *sizes = realloc(pool_mgr->compact_sizes, capacity * sizeof(uint32_t));
+    if (sizes == NULL)
+        return ALLOC_FAIL;
+    pool_mgr->compact_sizes = sizes;
+
+    uint64_t *allocated = realloc(pool_mgr->compact_allocated, capacity / 64 * sizeof(uint64_t));
+    if (allocated == NULL)
+        return ALLOC_FAIL;
+    pool_mgr->compact_allocated = allocated;
+
+    uint32_t *offsets = realloc(pool_mgr->compact_offsets, capacity * sizeof(uint32_t));
+    if (offsets == NULL)
+        return ALLOC_FAIL;
+    pool_mgr->compact_offsets = offsets;
+
+    alloc_pt *records = realloc(pool_mgr->compact_records, capacity * sizeof(alloc_pt));
+    if (records == NULL)
+        return ALLOC_FAIL;
+    pool_mgr->compact_records = records;
+
+    // the bits past the last segment are always clear
+    unsigned w = pool_mgr->compact_capacity / 64;
+    while (w < capacity / 64)
+        allocated[w++] = 0;
+
+    //update capacity
+    pool_mgr->compact_capacity = capacity;
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_resize_record_heap(pool_mgr_pt pool_mgr) {
+
+    // check if necessary (no unused record left)
+    if (pool_mgr->unused_records == NULL) {
+
+        // allocate one more chunk
+        record_chunk_pt chunk = calloc(1, sizeof(record_chunk_t) + MEM_RECORD_CHUNK_SIZE * sizeof(alloc_t));
+        if (chunk == NULL)
+            return ALLOC_FAIL;
+
+        chunk->next = pool_mgr->record_heap;
+        pool_mgr->record_heap = chunk;
+
+        // stack up the new records as unused
+        unsigned i = MEM_RECORD_CHUNK_SIZE;
+        while (i-- > 0) {
+            chunk->records[i].mem = (char *) pool_mgr->unused_records;
+            pool_mgr->unused_records = &chunk->records[i];
+        }
+    }
+
+    return ALLOC_OK;
+}
+
+static void _mem_insert_compact_seg(pool_mgr_pt pool_mgr, unsigned pos) {
+
+    // make room at pos, moving the segments from there on up by one
+    unsigned n = pool_mgr->num_compact_segs;
+    uint32_t *sizes = pool_mgr->compact_sizes;
+    uint32_t *offsets = pool_mgr->compact_offsets;
+    alloc_pt *records = pool_mgr->compact_records;
+    unsigned i = n;
+    while (i > pos) {
+        sizes[i] = sizes[i - 1];
+        offsets[i] = offsets[i - 1];
+        records[i] = records[i - 1];
+        i--;
+    }
+
+    // the bits too, a word at a time, carrying the top bit of each word
+    // into the next
+    uint64_t *bits = pool_mgr->compact_allocated;
+    unsigned w = n / 64;
+    while (w > pos / 64) {
+        bits[w] = (bits[w] << 1) | (bits[w - 1] >> 63);
+        w--;
+    }
+    uint64_t below = (1ull << (pos % 64)) - 1;
+    bits[w] = (bits[w] & below) | ((bits[w] & ~below) << 1);
+
+    pool_mgr->num_compact_segs++;
+}
+
+static void _mem_remove_compact_seg(pool_mgr_pt pool_mgr, unsigned pos) {
+
+    // close the hole at pos, moving the segments after it down by one
+    unsigned n = pool_mgr->num_compact_segs;
+    uint32_t *sizes = pool_mgr->compact_sizes;
+    uint32_t *offsets = pool_mgr->compact_offsets;
+    alloc_pt *records = pool_mgr->compact_records;
+    unsigned i = pos;
+    while (i + 1 < n) {
+        sizes[i] = sizes[i + 1];
+        offsets[i] = offsets[i + 1];
+        records[i] = records[i + 1];
+        i++;
+    }
+
+    // the bits too, carrying the bottom bit of each word into the one
+    // before it
+    uint64_t *bits = pool_mgr->compact_allocated;
+    unsigned w = pos / 64;
+    uint64_t below = (1ull << (pos % 64)) - 1;
+    bits[w] = (bits[w] & below) | ((bits[w] >> 1) & ~below);
+    while (w < (n - 1) / 64) {
+        bits[w] |= bits[w + 1] << 63;
+        bits[w + 1] >>= 1;
+        w++;
+    }
+
+    pool_mgr->num_compact_segs--;
+}
+
+static alloc_pt _mem_new_compact_alloc(pool_mgr_pt pool_mgr, size_t size) {
+
+    // make sure there's room for the remaining gap and a record, before
+    // anything changes
+    // (the size of a gap that fits is a 32-bit one, too)
+    if (size > pool_mgr->pool.total_size ||
+        _mem_resize_compact_segs(pool_mgr) == ALLOC_FAIL ||
+        _mem_resize_record_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+
+    // find the first (FIRST_FIT) or smallest (BEST_FIT) gap that fits,
+    // looking only at the sizes and the bits: the first one the kernel
+    // finds, or, for BEST_FIT, the smallest of all it finds, unless one
+    // fits exactly
+    unsigned n = pool_mgr->num_compact_segs;
+    uint32_t *sizes = pool_mgr->compact_sizes;
+    uint64_t *bits = pool_mgr->compact_allocated;
+    unsigned pos = fit_kernel(sizes, bits, 0, n, (uint32_t) size);
+    if (pool_mgr->pool.policy == BEST_FIT) {
+        unsigned i = pos;
+        while (i != MEM_COMPACT_NIL && sizes[pos] != size) {
+            i = fit_kernel(sizes, bits, i + 1, n, (uint32_t) size);
+            if (i != MEM_COMPACT_NIL && sizes[i] < sizes[pos])
+                pos = i;
+        }
+    }
+
+    if (pos == MEM_COMPACT_NIL)
+        return NULL;
+
+    // split off the rest as a gap right after it, if any
+    if (sizes[pos] > size) {
+        _mem_insert_compact_seg(pool_mgr, pos + 1);
+        sizes[pos + 1] = sizes[pos] - (uint32_t) size;
+        pool_mgr->compact_offsets[pos + 1] = pool_mgr->compact_offsets[pos] + (uint32_t) size;
+    }
+    else
+        pool_mgr->pool.num_gaps--;
+
+    // take a record off the stack for it
+    alloc_pt record = pool_mgr->unused_records;
+    pool_mgr->unused_records = (alloc_pt) record->mem;
+    record->size = size;
+    record->mem = pool_mgr->pool.mem + pool_mgr->compact_offsets[pos];
+
+    // update metadata (num_allocs, alloc_size)
+    sizes[pos] = (uint32_t) size;
+    bits[pos / 64] |= 1ull << (pos % 64);
+    pool_mgr->compact_records[pos] = record;
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += size;
+
+    return record;
+}
+
+static unsigned _mem_find_compact_seg(pool_mgr_pt pool_mgr, const char *mem) {
+
+    // the memory has to be in the pool
+    uintptr_t start = (uintptr_t) pool_mgr->pool.mem;
+    if ((uintptr_t) mem < start || (uintptr_t) mem - start >= pool_mgr->pool.total_size)
+        return MEM_COMPACT_NIL;
+
+    // binary search the offsets, which are in address order
+    uint32_t offset = (uint32_t) ((uintptr_t) mem - start);
+    unsigned lo = 0, hi = pool_mgr->num_compact_segs;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (pool_mgr->compact_offsets[mid] < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // and it has to be the start of an allocation
+    if (lo == pool_mgr->num_compact_segs || pool_mgr->compact_offsets[lo] != offset ||
+        ((pool_mgr->compact_allocated[lo / 64] >> (lo % 64)) & 1) == 0)
+        return MEM_COMPACT_NIL;
+
+    return lo;
+}
+
+static void _mem_del_compact_alloc(pool_mgr_pt pool_mgr, unsigned pos) {
+
+    uint32_t *sizes = pool_mgr->compact_sizes;
+    uint64_t *bits = pool_mgr->compact_allocated;
+
+    // put the record back on the stack
+    // update metadata (num_allocs, alloc_size)
+    alloc_pt record = pool_mgr->compact_records[pos];
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= record->size;
+    record->size = 0;
+    record->mem = (char *) pool_mgr->unused_records;
+    pool_mgr->unused_records = record;
+
+    // convert to a gap
+    bits[pos / 64] &= ~(1ull << (pos % 64));
+    pool_mgr->compact_records[pos] = NULL;
+    pool_mgr->pool.num_gaps++;
+
+    // if the next segment is also a gap, merge it into this one
+    if (pos + 1 < pool_mgr->num_compact_segs &&
+        ((bits[(pos + 1) / 64] >> ((pos + 1) % 64)) & 1) == 0) {
+        sizes[pos] += sizes[pos + 1];
+        _mem_remove_compact_seg(pool_mgr, pos + 1);
+        pool_mgr->pool.num_gaps--;
+    }
+
+    // if the previous segment is also a gap, merge this one into it
+    if (pos > 0 && ((bits[(pos - 1) / 64] >> ((pos - 1) % 64)) & 1) == 0) {
+        sizes[pos - 1] += sizes[pos];
+        _mem_remove_compact_seg(pool_mgr, pos);
+        pool_mgr->pool.num_gaps--;
+    }
+}
+
+static alloc_status _mem_init_bitmap(pool_mgr_pt pool_mgr) {
+
+    // a level per 64-fold, up to one that fits in a single word
+    size_t n = pool_mgr->num_granules;
+    unsigned num_levels = 1;
+    size_t words = (n + 63) / 64;
+    while (words > 1) {
+        words = (words + 63) / 64;
+        num_levels++;
+    }
+    if (num_levels > MEM_BITMAP_MAX_LEVELS)
+        return ALLOC_FAIL;
+
+    pool_mgr->bitmap_levels = calloc(num_levels, sizeof(bitmap_level_t));
+    pool_mgr->bitmap_starts = calloc((n + 63) / 64, sizeof(uint64_t));
+    if (pool_mgr->bitmap_levels == NULL || pool_mgr->bitmap_starts == NULL)
+        return ALLOC_FAIL;
+    pool_mgr->num_bitmap_levels = num_levels;
+
+    // allocate the levels, all bits clear
+    size_t bits = n;
+    unsigned level = 0;
+    while (level < num_levels) {
+        bitmap_level_pt l = &pool_mgr->bitmap_levels[level];
+        l->num_words = (bits + 63) / 64;
+        l->bits = calloc(l->num_words, sizeof(uint64_t));
+        if (l->bits == NULL)
+            return ALLOC_FAIL;
+        bits = l->num_words;
+        level++;
+    }
+
+    // all the granules are free, and they are one gap
+    _mem_set_granules(pool_mgr, 0, n, 1);
+    pool_mgr->pool.num_gaps = 1;
+
+    return ALLOC_OK;
+}
+
+static void _mem_set_granules(pool_mgr_pt pool_mgr, size_t start, size_t count, int free) {
+
+    // set or clear the bits of the run, a word at a time
+    bitmap_level_pt levels = pool_mgr->bitmap_levels;
+    size_t i = start;
+    size_t end = start + count;
+    while (i < end) {
+        size_t w = i / 64;
+        unsigned lo = (unsigned) (i % 64);
+        unsigned hi = (end - w * 64 < 64) ? (unsigned) (end - w * 64) : 64;
+        uint64_t mask = ((hi == 64) ? ~0ull : (1ull << hi) - 1) & (~0ull << lo);
+
+        uint64_t old = levels[0].bits[w];
+        levels[0].bits[w] = free ? (old | mask) : (old & ~mask);
+
+        // a word that became 0 or stopped being 0 flips its bit in the
+        // level above, and so on up
+        size_t word = w;
+        unsigned level = 0;
+        while (level + 1 < pool_mgr->num_bitmap_levels &&
+               (old == 0) != (levels[level].bits[word] == 0)) {
+            uint64_t *above = &levels[level + 1].bits[word / 64];
+            old = *above;
+            if (levels[level].bits[word] != 0)
+                *above |= 1ull << (word % 64);
+            else
+                *above &= ~(1ull << (word % 64));
+            word /= 64;
+            level++;
+        }
+
+        i = w * 64 + hi;
+    }
+}
+
+static size_t _mem_next_free_granule(pool_mgr_pt pool_mgr, size_t from) {
+
+    // look for a set bit from the position on in its word, and if there's
+    // none, go up a level and look from the next word on
+    bitmap_level_pt levels = pool_mgr->bitmap_levels;
+    size_t i = from;
+    unsigned level = 0;
+    while (1) {
+        size_t w = i / 64;
+        if (w >= levels[level].num_words)
+            return MEM_BITMAP_NIL;
+
+        uint64_t word = levels[level].bits[w] & (~0ull << (i % 64));
+        if (word != 0) {
+            i = w * 64 + _mem_lowest_bit(word);
+            break;
+        }
+
+        if (level + 1 == pool_mgr->num_bitmap_levels)
+            return MEM_BITMAP_NIL;
+        i = w + 1;
+        level++;
+    }
+
+    // then come back down, to the lowest set bit of each word found
+    while (level > 0) {
+        level--;
+        i = i * 64 + _mem_lowest_bit(levels[level].bits[i]);
+    }
+
+    return i;
+}
+
+static size_t _mem_next_bit(const uint64_t *bits, size_t from, size_t limit, int set) {
+
+    // the first bit from on that is set (or clear), a word at a time,
+    // else the limit
+    size_t i = from;
+    while (i < limit) {
+        uint64_t word = set ? bits[i / 64] : ~bits[i / 64];
+        word &= ~0ull << (i % 64);
+        if (word != 0) {
+            i = i / 64 * 64 + _mem_lowest_bit(word);
+            return (i < limit) ? i : limit;
+        }
+        i = (i / 64 + 1) * 64;
+    }
+
+    return limit;
+}
+
+static alloc_pt _mem_new_bitmap_alloc(pool_mgr_pt pool_mgr, size_t size) {
+
+    // make sure there's room for a record and its index entry, before
+    // anything changes
+    if (size > pool_mgr->pool.total_size ||
+        _mem_resize_addr_ix(pool_mgr) == ALLOC_FAIL ||
+        _mem_resize_record_heap(pool_mgr) == ALLOC_FAIL)
+        return NULL;
+
+    // find the first run of enough free granules: jump to the next free
+    // granule through the levels, and from there to the next allocated one
+    // (only as far as needed) through the bottom words
+    size_t n = pool_mgr->num_granules;
+    size_t count = (size + pool_mgr->bitmap_granule - 1) / pool_mgr->bitmap_granule;
+    uint64_t *free_bits = pool_mgr->bitmap_levels[0].bits;
+    size_t start = _mem_next_free_granule(pool_mgr, 0);
+    while (start != MEM_BITMAP_NIL) {
+        size_t limit = (n - start < count) ? n : start + count;
+        size_t end = _mem_next_bit(free_bits, start, limit, 0);
+        if (end - start == count)
+            break;
+        if (end == n)
+            return NULL;
+        start = _mem_next_free_granule(pool_mgr, end);
+    }
+
+    if (start == MEM_BITMAP_NIL)
+        return NULL;
+
+    // the gap goes away unless it's longer than the run
+    size_t end = start + count;
+    if (end == n || !((free_bits[end / 64] >> (end % 64)) & 1))
+        pool_mgr->pool.num_gaps--;
+
+    // mark the run allocated
+    _mem_set_granules(pool_mgr, start, count, 0);
+    pool_mgr->bitmap_starts[start / 64] |= 1ull << (start % 64);
+
+    // take a record off the stack for it, whole granules, and make it
+    // findable by its address
+    alloc_pt record = pool_mgr->unused_records;
+    pool_mgr->unused_records = (alloc_pt) record->mem;
+    record->size = count * pool_mgr->bitmap_granule;
+    record->mem = pool_mgr->pool.mem + start * pool_mgr->bitmap_granule;
+    _mem_add_to_addr_ix(pool_mgr, record);
+
+    // update metadata (num_allocs, alloc_size)
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += record->size;
+
+    return record;
+}
+
+static void _mem_del_bitmap_alloc(pool_mgr_pt pool_mgr, alloc_pt alloc) {
+
+    size_t n = pool_mgr->num_granules;
+    size_t start = (size_t) (alloc->mem - pool_mgr->pool.mem) / pool_mgr->bitmap_granule;
+    size_t count = alloc->size / pool_mgr->bitmap_granule;
+    size_t end = start + count;
+    uint64_t *free_bits = pool_mgr->bitmap_levels[0].bits;
+
+    // the run becomes a gap, merging with a gap on either side
+    int prev_free = start > 0 && ((free_bits[(start - 1) / 64] >> ((start - 1) % 64)) & 1);
+    int next_free = end < n && ((free_bits[end / 64] >> (end % 64)) & 1);
+    pool_mgr->pool.num_gaps += 1;
+    pool_mgr->pool.num_gaps -= prev_free + next_free;
+
+    // mark the run free
+    _mem_set_granules(pool_mgr, start, count, 1);
+    pool_mgr->bitmap_starts[start / 64] &= ~(1ull << (start % 64));
+
+    // update metadata (num_allocs, alloc_size)
+    pool_mgr->pool.num_allocs--;
+    pool_mgr->pool.alloc_size -= alloc->size;
+
+    // it's no longer findable by its address, and the record goes back on
+    // the stack
+    _mem_remove_from_addr_ix(pool_mgr, alloc);
+    alloc->size = 0;
+    alloc->mem = (char *) pool_mgr->unused_records;
+    pool_mgr->unused_records = alloc;
+}
+
+static alloc_status _mem_coalesce_gap(pool_mgr_pt pool_mgr, node_pt node) {
+
+    // convert to gap node
+    node->used = 1;
+    node->allocated = 0;
+
+    // a buddy block only ever merges with its buddy
+    if (pool_mgr->pool.policy == BUDDY) {
+        _mem_merge_buddy(pool_mgr, node);
+        return ALLOC_OK;
+    }
+
+    // if the next node in the list is also a gap, merge into node-to-delete
+    // (not across the end of an arena)
+    if (node->next != NULL && node->next->allocated == 0 && !node->next->arena_start) {
+
+        //   add the size to the node-to-delete
+        node->alloc_record.size += node->next->alloc_record.size;
+
+        //   remove the next node from gap index
+        _mem_remove_gap(pool_mgr, node->next->alloc_record.size, node->next);
+
+
+        //   update linked list:
+        node_pt next = node->next;
+        node->next = next->next;
+        if (next->next != NULL)
+            next->next->prev = node;
+        else
+            pool_mgr->last_node = node;
+
+        //   update node as unused
+        //   update metadata (used nodes)
+        _mem_push_unused_node(pool_mgr, next);
+        pool_mgr->used_nodes--;
+
+    }
+
+
+
+    // this merged node-to-delete might need to be added to the gap index
+    // but one more thing to check...
+    // if the previous node in the list is also a gap, merge into previous!
+
+    if (node->prev != NULL && node->prev->allocated == 0 && !node->arena_start) {
+
+        //   remove the previous node from gap index
+        //   (before its size, which is part of the index key, changes)
+        if (_mem_remove_gap(pool_mgr,
+                            node->prev->alloc_record.size,
+                            node->prev) == ALLOC_FAIL) {
+            return ALLOC_FAIL;
+        }
+
+        //   add the size of node-to-delete to the previous
+        node_pt prev = node->prev;
+        prev->alloc_record.size += node->alloc_record.size;
+
+        //   update linked list
+        prev->next = node->next;
+        if (node->next != NULL)
+            node->next->prev = prev;
+        else
+            pool_mgr->last_node = prev;
+
+        //   update node-to-delete as unused
+        //   update metadata (used_nodes)
+        _mem_push_unused_node(pool_mgr, node);
+        pool_mgr->used_nodes--;
+
+        //   change the node to add to the previous node!
+        node = prev;
+    }
+
+    // add the resulting node to the gap index
+    _mem_add_gap(pool_mgr, node->alloc_record.size, node);
+
+    // give its pages back, if it's large enough
+    if (pool_mgr->trim_threshold > 0 && node->alloc_record.size >= pool_mgr->trim_threshold)
+        _mem_release_gap(pool_mgr, node);
+
+    return ALLOC_OK;
+}
+
+static alloc_status _mem_add_to_quick_list(pool_mgr_pt pool_mgr, node_pt node) {
+
+    // the list of its exact size, unless that's full
+    quick_list_pt list = &pool_mgr->quick_lists[node->alloc_record.size - 1];
+    if (list->count == MEM_QUICK_LIST_DEPTH)
+        return ALLOC_FAIL;
+
+    // push the node, which stays allocated as far as its neighbors are
+    // concerned, so they don't merge with it
+    node->next_gap = list->head;
+    list->head = node;
+    list->count++;
+    pool_mgr->num_quick++;
+
+    return ALLOC_OK;
+}
+
+static alloc_pt _mem_new_quick_alloc(pool_mgr_pt pool_mgr, size_t size) {
+
+    // pop the latest block freed with this size
+    quick_list_pt list = &pool_mgr->quick_lists[size - 1];
+    node_pt node = list->head;
+    list->head = node->next_gap;
+    list->count--;
+    pool_mgr->num_quick--;
+    node->next_gap = NULL;
+
+    // update metadata (num_allocs, alloc_size)
+    pool_mgr->pool.num_allocs++;
+    pool_mgr->pool.alloc_size += size;
+    pool_mgr->next_fit_cursor = node->alloc_record.mem + size;
+
+    // make it findable by its address again
+    _mem_add_to_addr_ix(pool_mgr, &node->alloc_record);
+
+    return &node->alloc_record;
+}
+
+static void _mem_flush_quick_lists(pool_mgr_pt pool_mgr) {
+
+    // convert every block on the lists to a gap, merging as it goes
+    unsigned i = 0;
+    while (pool_mgr->num_quick > 0 && i < MEM_QUICK_LISTS) {
+        quick_list_pt list = &pool_mgr->quick_lists[i];
+        while (list->head != NULL) {
+            node_pt node = list->head;
+            list->head = node->next_gap;
+            list->count--;
+            pool_mgr->num_quick--;
+            node->next_gap = NULL;
+            _mem_coalesce_gap(pool_mgr, node);
+        }
+        i++;
+    }
+}
+
+static fit_kernel_t _mem_select_fit_kernel() {
+
+    // the widest kernel the CPU runs, else the scalar one
+#ifdef MEM_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return _mem_find_fit_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return _mem_find_fit_sse2;
+#endif
+    return _mem_find_fit_scalar;
+}
+
+static unsigned _mem_find_fit_scalar(const uint32_t *sizes, const uint64_t *allocated,
+                                     unsigned from, unsigned n, uint32_t size) {
+
+    // one segment at a time, skipping a whole word of allocations at once
+    unsigned i = from;
+    while (i < n) {
+        if (allocated[i / 64] == ~0ull) {
+            i = (i / 64 + 1) * 64;
+            continue;
+        }
+        if (((allocated[i / 64] >> (i % 64)) & 1) == 0 && sizes[i] >= size)
+            return i;
+        i++;
+    }
+
+    return MEM_COMPACT_NIL;
+}
+
+#ifdef MEM_X86_SIMD
+__attribute__((target("sse2")))
+static unsigned _mem_find_fit_sse2(const uint32_t *sizes, const uint64_t *allocated,
+                                   unsigned from, unsigned n, uint32_t size) {
+
+    // SSE2 only compares signed, so flip the top bits of both sides, and
+    // compare sizes > size - 1
+    const __m128i bias = _mm_set1_epi32((int) 0x80000000u);
+    const __m128i key = _mm_xor_si128(_mm_set1_epi32((int) (size - 1)), bias);
+
+    // four segments at a time, from the block of four that from is in
+    // (the arrays hold a multiple of 64, so whole blocks can be read)
+    unsigned i = from & ~3u;
+    while (i < n) {
+        uint64_t word = allocated[i / 64];
+        if (word == ~0ull) {
+            i = (i / 64 + 1) * 64;
+            continue;
+        }
+
+        // a lane per size that fits, cleared for allocations and for the
+        // segments out of range
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (sizes + i)), bias);
+        unsigned mask = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, key)));
+        mask &= ~(unsigned) (word >> (i % 64)) & 0xf;
+        if (i < from)
+            mask &= ~0u << (from - i);
+        if (n - i < 4)
+            mask &= (1u << (n - i)) - 1;
+
+        if (mask != 0)
+            return i + _mem_lowest_bit(mask);
+        i += 4;
+    }
+
+    return MEM_COMPACT_NIL;
+}
+
+__attribute__((target("avx2")))
+static unsigned _mem_find_fit_avx2(const uint32_t *sizes, const uint64_t *allocated,
+                                   unsigned from, unsigned n, uint32_t size) {
+
+    // like the SSE2 kernel, eight segments at a time
+    const __m256i bias = _mm256_set1_epi32((int) 0x80000000u);
+    const __m256i key = _mm256_xor_si256(_mm256_set1_epi32((int) (size - 1)), bias);
+
+    unsigned i = from & ~7u;
+    while (i < n) {
+        uint64_t word = allocated[i / 64];
+        if (word == ~0ull) {
+            i = (i / 64 + 1) * 64;
+            continue;
+        }
+
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (sizes + i)), bias);
+        unsigned mask = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, key)));
+        mask &= ~(unsigned) (word >> (i % 64)) & 0xff;
+        if (i < from)
+            mask &= ~0u << (from - i);
+        if (n - i < 8)
+            mask &= (1u << (n - i)) - 1;
+
+        if (mask != 0)
+            return i + _mem_lowest_bit(mask);
+        i += 8;
+    }
+
+    return MEM_COMPACT_NIL;
+}
+#endif
@@ -6,18 +6,50 @@
 #define DENVER_OS_PA_C_MEM_POOL_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 /* type declarations */
 
-typedef enum _alloc_policy { FIRST_FIT, BEST_FIT } alloc_policy;
+typedef enum _alloc_policy { FIRST_FIT, BEST_FIT, SEGREGATED_FIT, TLSF, BUDDY, SLAB, NEXT_FIT, BITMAP } alloc_policy;
+
+typedef enum _pool_flags {
+    POOL_BOUNDARY_TAGS = 0x1, // keep segment metadata in the pool memory itself
+    POOL_COMPACT_NODES = 0x2, // keep segment metadata in 32-bit arrays (pools under 4 GiB)
+    POOL_QUICK_LISTS   = 0x4, // reuse small freed blocks by exact size, coalescing later
+    POOL_HUGE_PAGES    = 0x8, // back the pool with 2 MiB pages, if the system has them
+    POOL_GROWABLE      = 0x10, // map another arena when the pool runs out
+    POOL_RESERVE       = 0x20  // reserve a range for the pool to grow into in place
+} pool_flags;
+
+typedef enum _pool_backing {
+    BACKING_HEAP,        // calloc, where there's no mmap
+    BACKING_PAGES,       // anonymous mmap of normal pages
+    BACKING_THP_ADVISED, // normal pages aligned to 2 MiB, advised to be transparent huge pages
+    BACKING_HUGETLB      // explicit (reserved) huge pages
+} pool_backing;
+
+typedef enum _search_kernel {
+    KERNEL_SCALAR, // one segment at a time
+    KERNEL_SSE2,   // 4 segments at a time, on x86 CPUs with SSE2
+    KERNEL_AVX2    // 8 segments at a time, on x86 CPUs with AVX2
+} search_kernel;
+
+typedef struct _pool_options {
+    unsigned flags; // pool_flags, or-ed together
+    size_t object_size; // SLAB: size of every allocation
+    size_t granule_size; // BITMAP: unit of allocation, 0 for the default of 64 bytes
+    size_t reserve_size; // POOL_RESERVE: range to reserve, 0 for the default of 1 GiB (or 4 times the size)
+    size_t trim_threshold; // node heap: release the pages of gaps this large as they form, 0 for never
+} pool_options_t, *pool_options_pt;
 
 typedef struct _pool {
     char *mem;
     alloc_policy policy;
-    size_t total_size;
+    size_t total_size; // of all the arenas, in a growable pool
     size_t alloc_size;
     unsigned num_allocs;
     unsigned num_gaps;
+    pool_backing backing; // what pool.mem was mapped with
 } pool_t, *pool_pt;
 
 
@@ -49,6 +81,9 @@ mem_free();
 pool_pt
 mem_pool_open(size_t size, alloc_policy policy);
 
+pool_pt
+mem_pool_open_ex(size_t size, alloc_policy policy, const pool_options_t *options);
+
 alloc_status
 mem_pool_close(pool_pt pool);
 
@@ -58,7 +93,32 @@ mem_new_alloc(pool_pt pool, size_t size);
 alloc_status
 mem_del_alloc(pool_pt pool, alloc_pt alloc);
 
+char *
+mem_new_alloc_addr(pool_pt pool, size_t size);
+
+alloc_status
+mem_del_alloc_addr(pool_pt pool, char *mem);
+
+alloc_pt
+mem_new_alloc_aligned(pool_pt pool, size_t size, size_t alignment);
+
+alloc_pt
+mem_resize_alloc(pool_pt pool, alloc_pt alloc, size_t size);
+
+alloc_status
+mem_pool_trim(pool_pt pool);
+
+alloc_pt
+mem_new_alloc_zeroed(pool_pt pool, size_t size);
+
 void
 mem_inspect_pool(pool_pt pool, pool_segment_pt *segments, unsigned *num_segments);
 
+alloc_status
+mem_check_pool(pool_pt pool);
+
+alloc_status
+mem_search_segments(search_kernel kernel, const uint32_t *sizes, const uint64_t *allocated,
+                    unsigned from, unsigned n, uint32_t size, unsigned *found);
+
 #endif //DENVER_OS_PA_C_MEM_POOL_H
@@ -119,6 +119,37 @@ static void check_metadata(pool_pt pool,
 #endif
 }
 
+static pool_pt open_pool(size_t size, alloc_policy policy, const pool_options_t *options) {
+    static const char *POLICY_NAMES[] =
+            { "FIRST_FIT", "BEST_FIT", "SEGREGATED_FIT", "TLSF", "BUDDY", "SLAB", "NEXT_FIT", "BITMAP" };
+    alloc_status status;
+    pool_pt pool = NULL;
+
+    status = mem_init();
+    assert_int_equal(status, ALLOC_OK);
+
+    INFO("Allocating pool of %lu bytes with policy %s and flags 0x%x\n",
+         (long) size, POLICY_NAMES[policy], (options == NULL) ? 0 : options->flags);
+    pool = mem_pool_open_ex(size, policy, options);
+    assert_non_null(pool);
+
+    return pool;
+}
+
+static int pool_teardown(void **state) {
+    pool_pt pool = *state;
+    alloc_status status;
+
+    INFO("Closing pool\n");
+    status = mem_pool_close(pool);
+    assert_int_equal(status, ALLOC_OK);
+
+    status = mem_free();
+    assert_int_equal(status, ALLOC_OK);
+
+    return 0;
+}
+
 
 
 /*******************************************/
@@ -469,33 +500,7 @@ static void test_pool_bf_metadata(void **state) {
 /*******************************************/
 
 static int pool_ff_setup(void **state) {
-    alloc_status status;
-    const alloc_policy POOL_POLICY = FIRST_FIT;
-    pool_pt pool = NULL;
-
-    status = mem_init();
-    assert_int_equal(status, ALLOC_OK);
-
-    INFO("Allocating pool of %lu bytes with policy %s\n",
-         (long) POOL_SIZE, (POOL_POLICY == FIRST_FIT) ? "FIRST_FIT" : "BEST_FIT");
-    pool = mem_pool_open(POOL_SIZE, POOL_POLICY);
-    assert_non_null(pool);
-
-    *state = pool;
-
-    return 0;
-}
-
-static int pool_ff_teardown(void **state) {
-    pool_pt pool = *state;
-    alloc_status status;
-
-    INFO("Closing pool\n");
-    status = mem_pool_close(pool);
-    assert_int_equal(status, ALLOC_OK);
-
-    status = mem_free();
-    assert_int_equal(status, ALLOC_OK);
+    *state = open_pool(POOL_SIZE, FIRST_FIT, NULL);
 
     return 0;
 }
@@ -1538,33 +1543,7 @@ static void test_pool_scenario10(void **state) {
 /*******************************************/
 
 static int pool_bf_setup(void **state) {
-    alloc_status status;
-    const alloc_policy POOL_POLICY = BEST_FIT;
-    pool_pt pool = NULL;
-
-    status = mem_init();
-    assert_int_equal(status, ALLOC_OK);
-
-    INFO("Allocating pool of %lu bytes with policy %s\n",
-         (long) POOL_SIZE, (POOL_POLICY == FIRST_FIT) ? "FIRST_FIT" : "BEST_FIT");
-    pool = mem_pool_open(POOL_SIZE, POOL_POLICY);
-    assert_non_null(pool);
-
-    *state = pool;
-
-    return 0;
-}
-
-static int pool_bf_teardown(void **state) {
-    pool_pt pool = *state;
-    alloc_status status;
-
-    INFO("Closing pool\n");
-    status = mem_pool_close(pool);
-    assert_int_equal(status, ALLOC_OK);
-
-    status = mem_free();
-    assert_int_equal(status, ALLOC_OK);
+    *state = open_pool(POOL_SIZE, BEST_FIT, NULL);
 
     return 0;
 }
@@ -2318,141 +2297,1954 @@ static void test_pool_scenario19(void **state) {
 }
 
 /*******************************************/
-/***          5. STRESS TEST             ***/
-/***                                     ***/
-/***         [non-functional]            ***/
-/***         [see NOTE below]            ***/
+/***     5. SEGREGATED_FIT SCENARIOS     ***/
 /*******************************************/
 
-void test_pool_stresstest(void **state) {
-    (void) state; /* unused */
+static int pool_sf_setup(void **state) {
+    *state = open_pool(POOL_SIZE, SEGREGATED_FIT, NULL);
 
-    const unsigned num_pools = 200;
-    const unsigned num_allocations = 1000;
-    const unsigned min_alloc_size = 10;
-    const unsigned pool_size =
-            (num_allocations / 2) *
-            (2 * min_alloc_size + (num_allocations - 1) * min_alloc_size);
-    assert_int_equal(pool_size, 5005000);
+    return 0;
+}
+
+static void test_pool_scenario20(void **state) {
+    pool_pt pool = *state;
 
+    /*
+     * Scenario 20:
+     *
+     * 1. Allocate 100, 1000, 100, 5000. The rest is a gap.
+     * 2. Deallocate the two 100 allocations. Both gaps are in the
+     *    64-127 size class, the most recently freed one first.
+     * 3. Allocate 100. It goes into the second 100 gap.
+     * 4. Allocate 90. It goes into the first 100 gap, leaving 10.
+     * 5. Allocate 200. The 128-255 size class is empty, so it comes
+     *    from the next non-empty class up, the gap at the end.
+     * 6. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    alloc_pt alloc3 = mem_new_alloc(pool, 5000);
+    assert_non_null(alloc3);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    pool_segment_t exp1[5] =
+            {
+                    {100, 0},
+                    {1000, 1},
+                    {100, 0},
+                    {5000, 1},
+                    {pool->total_size - 6200, 0}
+            };
+    check_pool(pool, exp1);
+    assert_int_equal(pool->num_gaps, 3);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc4);
+
+    pool_segment_t exp2[5] =
+            {
+                    {100, 0},
+                    {1000, 1},
+                    {100, 1},
+                    {5000, 1},
+                    {pool->total_size - 6200, 0}
+            };
+    check_pool(pool, exp2);
+
+    alloc_pt alloc5 = mem_new_alloc(pool, 90);
+    assert_non_null(alloc5);
+
+    alloc_pt alloc6 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc6);
+
+    pool_segment_t exp3[7] =
+            {
+                    {90, 1},
+                    {10, 0},
+                    {1000, 1},
+                    {100, 1},
+                    {5000, 1},
+                    {200, 1},
+                    {pool->total_size - 6400, 0}
+            };
+    check_pool(pool, exp3);
+    assert_int_equal(pool->num_gaps, 2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc6), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc5), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
 
-    pool_pt pools[num_pools];
-    alloc_pt allocations[num_pools][num_allocations];
+
+/*******************************************/
+/***          6. TLSF SCENARIOS          ***/
+/*******************************************/
+
+static int pool_tlsf_setup(void **state) {
+    *state = open_pool(POOL_SIZE, TLSF, NULL);
+
+    return 0;
+}
+
+static void test_pool_scenario21(void **state) {
+    pool_pt pool = *state;
 
     /*
-     * NOTE: This will work iff the address of the allocation
-     * in the pool is returned to the user instead of the
-     * address of the allocation record. Since allocation records
-     * are a part of the nodes, when the node heap is reallocated
-     * the node addresses shift with it, and so do the allocation
-     * record addresses. The allocation addresses on the pool
-     * remain the same, however, so they can be returned to the
-     * user and gotten from the user upon request for deletion.
+     * Scenario 21:
+     *
+     * 1. Allocate 101, 1000. The rest is a gap.
+     * 2. Deallocate the 101 allocation. The gap is in the 100-103
+     *    size class.
+     * 3. Allocate 101. It is rounded up to the 104-107 class, so the
+     *    101 gap, which may be too small for its class, is not
+     *    searched, and it comes from the gap at the end.
+     * 4. Allocate 100. Any gap of the 100-103 class fits, so it goes
+     *    into the 101 gap, leaving 1.
+     * 5. Deallocate everything. Pool is again one single gap.
      */
 
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 101);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 101);
+    assert_non_null(alloc2);
+
+    pool_segment_t exp1[4] =
+            {
+                    {101, 0},
+                    {1000, 1},
+                    {101, 1},
+                    {pool->total_size - 1202, 0}
+            };
+    check_pool(pool, exp1);
+    assert_int_equal(pool->num_gaps, 2);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc3);
+
+    pool_segment_t exp2[5] =
+            {
+                    {100, 1},
+                    {1, 0},
+                    {1000, 1},
+                    {101, 1},
+                    {pool->total_size - 1202, 0}
+            };
+    check_pool(pool, exp2);
+    assert_int_equal(pool->num_gaps, 2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***          7. BUDDY SCENARIOS         ***/
+/*******************************************/
+
+static int pool_buddy_setup(void **state) {
+    *state = open_pool(POOL_SIZE, BUDDY, NULL);
+
+    return 0;
+}
+
+static void test_pool_scenario22(void **state) {
+    pool_pt pool = *state;
+
     /*
-     * Testing dynamic reallocation of pool structures:
+     * Scenario 22:
      *
-     * 1. 200 pools of 5005000 each (many pools)
-     * 2. In each pool 1000 allocations of different sizes (many allocations)
-     * 3. In each pool 500 deallocations (many gaps)
+     * 0. The pool of 1000000 bytes is cut into the powers of 2 it is
+     *    made of: 524288, 262144, 131072, 65536, 16384, 512, 64.
+     * 1. Allocate 100. It is rounded up to 128, and the 512 block is
+     *    halved twice, leaving gaps of 128 and 256.
+     * 2. Allocate 64. It takes the 64 block as is.
+     * 3. Allocate 100. It takes the 128 gap.
+     * 4. Deallocate the first 128. Its buddy is allocated, so it stays.
+     * 5. Deallocate the second 128. It merges with its buddy, and the
+     *    resulting 256 with its own, back into the 512 block.
+     * 6. Deallocate the 64. Pool is again the initial blocks.
      */
 
-    // initialize store
-    assert_int_equal(mem_init(), ALLOC_OK);
+    pool_segment_t exp0[7] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {512, 0},
+                    {64, 0}
+            };
+    check_pool(pool, exp0);
+    assert_int_equal(pool->num_gaps, 7);
 
-    // allocate pools
-    for (unsigned pix=0; pix < num_pools; ++pix) {
-        // open pool
-        pools[pix] =
-                mem_pool_open(pool_size, (pix % 2) ? FIRST_FIT : BEST_FIT);
-        assert_non_null(pools[pix]);
-        // allocate pool
-        unsigned allocated = 0;
-        for (unsigned aix=0; aix < num_allocations; ++aix) {
-            allocations[pix][aix] =
-                    mem_new_alloc(pools[pix], (aix + 1) * min_alloc_size);
-            allocated += (aix + 1) * min_alloc_size;
-            if (!allocations[pix][aix]) {
-                INFO("ASSERT WILL FAIL at pix = %u, aix = %u, allocated = %u\n", pix, aix, allocated);
-            }
-            assert_non_null(allocations[pix][aix]);
-        }
-        // delete every other allocation
-        for (unsigned aix=0; aix < num_allocations; ++aix) {
-            if (aix % 2) {
-                assert_int_equal(
-                        mem_del_alloc(pools[pix], allocations[pix][aix]),
-                        ALLOC_OK);
-                allocations[pix][aix] = NULL;
-            }
-        }
-    }
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_int_equal(alloc0->size, 128);
+    char *mem0 = alloc0->mem;
+    alloc_pt alloc1 = mem_new_alloc(pool, 64);
+    assert_non_null(alloc1);
+    char *mem1 = alloc1->mem;
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    char *mem2 = alloc2->mem;
 
-    // delete pools
-    for (unsigned pix=0; pix < num_pools; ++pix) {
-        // delete pool's allocations
-        for (unsigned aix=0; aix < num_allocations; ++aix) {
-            if (allocations[pix][aix]) {
-                // delete allocation
-                assert_int_equal(
-                    mem_del_alloc(pools[pix], allocations[pix][aix]),
-                    ALLOC_OK);
-            }
-        }
-        // close pool
-        assert_int_equal(mem_pool_close(pools[pix]), ALLOC_OK);
-    }
+    pool_segment_t exp1[9] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {128, 1},
+                    {128, 1},
+                    {256, 0},
+                    {64, 1}
+            };
+    check_pool(pool, exp1);
+    assert_int_equal(pool->num_gaps, 6);
+    assert_int_equal(pool->alloc_size, 320);
 
-    // free store
-    assert_int_equal(mem_free(), ALLOC_OK);
+    // (the node heap may have grown, so deallocate by address)
+    assert_int_equal(mem_del_alloc_addr(pool, mem0), ALLOC_OK);
+
+    pool_segment_t exp2[9] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {128, 0},
+                    {128, 1},
+                    {256, 0},
+                    {64, 1}
+            };
+    check_pool(pool, exp2);
+
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_OK);
+
+    pool_segment_t exp3[7] =
+            {
+                    {524288, 0},
+                    {262144, 0},
+                    {131072, 0},
+                    {65536, 0},
+                    {16384, 0},
+                    {512, 0},
+                    {64, 1}
+            };
+    check_pool(pool, exp3);
+
+    assert_int_equal(mem_del_alloc_addr(pool, mem1), ALLOC_OK);
+
+    check_pool(pool, exp0);
 }
 
 
 /*******************************************/
-/***         6. DRIVER ROUTINE           ***/
+/***     8. BOUNDARY TAG SCENARIOS       ***/
 /*******************************************/
 
-int run_test_suite() {
-    const struct CMUnitTest tests[] = {
-            cmocka_unit_test(test_pool_store_smoketest),
-            cmocka_unit_test(test_pool_smoketest),
+static int pool_tags_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_BOUNDARY_TAGS };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario23(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 23:
+     *
+     * Every segment takes 32 bytes of tags, and its size rounded up
+     * to a multiple of 8. An allocation is reported at its size, and its
+     * tags and padding are counted in the gap after it.
+     *
+     * 1. Allocate 100, 1000, 100. The rest is a gap.
+     * 2. Deallocate the 1000 allocation. It has no gap neighbours.
+     * 3. Deallocate the first 100. It merges with the gap after it.
+     * 4. Deallocate the second 100. It merges with the gaps on both
+     *    sides. Pool is again one single gap.
+     * 5. Deallocate the second 100 again. It fails.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_int_equal(alloc0->size, 100);
+    assert_true(alloc0->mem == pool->mem + 24);
+    alloc_pt alloc1 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc1);
+    char *mem2 = mem_new_alloc_addr(pool, 100);
+    assert_non_null(mem2);
+
+    pool_segment_t exp1[4] =
+            {
+                    {100, 1},
+                    {1000, 1},
+                    {100, 1},
+                    {pool->total_size - 1200, 0}
+            };
+    check_pool(pool, exp1);
+    assert_int_equal(pool->alloc_size, 1200);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    pool_segment_t exp2[4] =
+            {
+                    {100, 1},
+                    {36 + 1032, 0},
+                    {100, 1},
+                    {36 + pool->total_size - 1304, 0}
+            };
+    check_pool(pool, exp2);
+    assert_int_equal(pool->num_gaps, 2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    pool_segment_t exp3[3] =
+            {
+                    {1168, 0},
+                    {100, 1},
+                    {36 + pool->total_size - 1304, 0}
+            };
+    check_pool(pool, exp3);
+
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_OK);
+
+    check_pool(pool, exp0);
+    assert_int_equal(pool->num_allocs, 0);
+    assert_int_equal(pool->alloc_size, 0);
+
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_FAIL);
+}
+
+
+/*******************************************/
+/***          9. SLAB SCENARIOS          ***/
+/*******************************************/
+
+static int pool_slab_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { .object_size = 100 };
+
+    *state = open_pool(1050, SLAB, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario24(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 24:
+     *
+     * The pool of 1050 bytes holds ten slots of 100 bytes, and a tail
+     * of 50 that's a gap for good.
+     *
+     * 1. Allocate 100, 60, 100. They take the first three slots, whole,
+     *    but record the sizes asked for.
+     * 2. Allocate 101. It fails, it doesn't fit in a slot.
+     * 3. Deallocate the 60 allocation. Its slot is the next one taken.
+     * 4. Allocate the remaining seven slots. One more fails.
+     * 5. Deallocate everything. Deallocating a slot twice fails.
+     */
+
+    pool_segment_t exp0[11] =
+            {
+                    {100, 0}, {100, 0}, {100, 0}, {100, 0}, {100, 0},
+                    {100, 0}, {100, 0}, {100, 0}, {100, 0}, {100, 0},
+                    {50, 0}
+            };
+    check_pool(pool, exp0);
+    check_metadata(pool, SLAB, 1050, 0, 0, 11);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_true(alloc0->mem == pool->mem);
+    alloc_pt alloc1 = mem_new_alloc(pool, 60);
+    assert_non_null(alloc1);
+    assert_int_equal(alloc1->size, 60);
+    assert_true(alloc1->mem == pool->mem + 100);
+    char *mem2 = mem_new_alloc_addr(pool, 100);
+    assert_true(mem2 == pool->mem + 200);
+
+    pool_segment_t exp1[11] =
+            {
+                    {100, 1}, {100, 1}, {100, 1}, {100, 0}, {100, 0},
+                    {100, 0}, {100, 0}, {100, 0}, {100, 0}, {100, 0},
+                    {50, 0}
+            };
+    check_pool(pool, exp1);
+    check_metadata(pool, SLAB, 1050, 260, 3, 8);
+
+    assert_null(mem_new_alloc(pool, 101));
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    alloc_pt allocs[8];
+    allocs[0] = mem_new_alloc(pool, 1);
+    assert_true(allocs[0] == alloc1);
+    assert_int_equal(allocs[0]->size, 1);
+
+    for (unsigned u = 1; u < 8; u++) {
+        allocs[u] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[u]);
+    }
+    assert_null(mem_new_alloc(pool, 1));
+    check_metadata(pool, SLAB, 1050, 901, 10, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_OK);
+    for (unsigned u = 0; u < 8; u++)
+        assert_int_equal(mem_del_alloc(pool, allocs[u]), ALLOC_OK);
+
+    check_pool(pool, exp0);
+    check_metadata(pool, SLAB, 1050, 0, 0, 11);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_FAIL);
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_FAIL);
+    assert_int_equal(mem_del_alloc_addr(pool, mem2 + 1), ALLOC_FAIL);
+}
+
+
+/*******************************************/
+/***        10. NEXT_FIT SCENARIOS       ***/
+/*******************************************/
+
+static int pool_nf_setup(void **state) {
+    *state = open_pool(POOL_SIZE, NEXT_FIT, NULL);
+
+    return 0;
+}
+static void test_pool_scenario25(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 25:
+     *
+     * 1. Allocate 100, 200, 300. Deallocate the 100.
+     * 2. Allocate 50. It goes after the 300, where the latest allocation
+     *    ended, not into the gap at the start of the pool.
+     * 3. Allocate the rest of the pool.
+     * 4. Allocate 50. Nothing fits past the end of the latest allocation,
+     *    so it wraps around to the gap at the start.
+     * 5. Deallocate the 200. It merges into the gap the latest allocation
+     *    ended at, which is where the next allocation of 100 goes.
+     * 6. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 200);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 300);
+    assert_non_null(alloc2);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc3);
+    assert_true(alloc3->mem == pool->mem + 600);
+
+    pool_segment_t exp1[5] =
+            {
+                    {100, 0},
+                    {200, 1},
+                    {300, 1},
+                    {50, 1},
+                    {pool->total_size - 650, 0}
+            };
+    check_pool(pool, exp1);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, pool->total_size - 650);
+    assert_non_null(alloc4);
+    alloc_pt alloc5 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc5);
+    assert_true(alloc5->mem == pool->mem);
+
+    pool_segment_t exp2[6] =
+            {
+                    {50, 1},
+                    {50, 0},
+                    {200, 1},
+                    {300, 1},
+                    {50, 1},
+                    {pool->total_size - 650, 1}
+            };
+    check_pool(pool, exp2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    alloc_pt alloc6 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc6);
+    assert_true(alloc6->mem == pool->mem + 50);
+
+    pool_segment_t exp3[6] =
+            {
+                    {50, 1},
+                    {100, 1},
+                    {150, 0},
+                    {300, 1},
+                    {50, 1},
+                    {pool->total_size - 650, 1}
+            };
+    check_pool(pool, exp3);
+    check_metadata(pool, NEXT_FIT, POOL_SIZE, pool->total_size - 150, 5, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc5), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc6), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***    11. COMPACT NODE SCENARIOS       ***/
+/*******************************************/
+
+static int pool_compact_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_COMPACT_NODES };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario26(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 26:
+     *
+     * The segments are kept in arrays, with a bit per segment for
+     * allocations, so this one goes past 64 of them.
+     *
+     * 1. Allocate 100 times 10. The rest is a gap.
+     * 2. Deallocate the 51st and then the 50th. They merge, moving the
+     *    segments after them down.
+     * 3. Allocate 20. It takes the merged gap, so the rest of the
+     *    allocations are back in place.
+     * 4. Deallocate everything. Deallocating one twice fails.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt allocs[100];
+    pool_segment_t exp1[101];
+    for (unsigned u = 0; u < 100; u++) {
+        allocs[u] = mem_new_alloc(pool, 10);
+        assert_non_null(allocs[u]);
+        assert_true(allocs[u]->mem == pool->mem + 10 * u);
+        exp1[u].size = 10;
+        exp1[u].allocated = 1;
+    }
+    exp1[100].size = pool->total_size - 1000;
+    exp1[100].allocated = 0;
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[50]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc_addr(pool, allocs[49]->mem), ALLOC_OK);
+
+    pool_segment_t exp2[100];
+    for (unsigned u = 0; u < 100; u++)
+        exp2[u] = exp1[(u < 50) ? u : u + 1];
+    exp2[49].size = 20;
+    exp2[49].allocated = 0;
+    check_pool(pool, exp2);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 980, 98, 2);
+
+    allocs[49] = mem_new_alloc(pool, 20);
+    assert_non_null(allocs[49]);
+    assert_true(allocs[49]->mem == pool->mem + 490);
+    exp2[49].allocated = 1;
+    check_pool(pool, exp2);
+
+    for (unsigned u = 0; u < 100; u++) {
+        if (u != 50)
+            assert_int_equal(mem_del_alloc(pool, allocs[u]), ALLOC_OK);
+    }
+
+    check_pool(pool, exp0);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 0, 0, 1);
+
+    assert_int_equal(mem_del_alloc(pool, allocs[0]), ALLOC_FAIL);
+}
+
+static void test_search_kernels(void **state) {
+    (void) state;
+
+    /*
+     * Search kernels:
+     *
+     * The SSE2 and AVX2 kernels, where they are compiled in and the CPU
+     * runs them, find the same segment as the scalar one, which finds the
+     * first one that fits.
+     *
+     * 1. Fill the sizes with small ones and ones over 2^31, which an
+     *    unsigned comparison has to get right, and the allocated bits
+     *    with random words, a full word and an empty one.
+     * 2. Search for each size from every start up to n, for n around the
+     *    vector widths and the bitmap words, so that the heads and the
+     *    tails are shorter than a vector.
+     * 3. Repeat with other random contents.
+     */
+
+    static const unsigned LENGTHS[] =
+            { 0, 1, 2, 3, 4, 5, 7, 8, 9, 13, 15, 16, 17, 31, 63, 64, 65, 66, 127, 128, 129, 191, 200, 256 };
+    static const uint32_t SIZES[] =
+            { 1, 2, 7, 8, 15, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffff8, 0xffffffff };
+    static const char *KERNEL_NAMES[] = { "scalar", "SSE2", "AVX2" };
+    uint32_t sizes[256];
+    uint64_t allocated[4];
+    unsigned found = 0;
+
+    srand(26);
+    for (unsigned round = 0; round < 4; round++) {
+        for (unsigned u = 0; u < 256; u++) {
+            switch (rand() % 3) {
+                case 0:  sizes[u] = (uint32_t) (rand() % 16); break;
+                case 1:  sizes[u] = 0x7ffffff8u + (uint32_t) (rand() % 16); break;
+                default: sizes[u] = 0xfffffff0u + (uint32_t) (rand() % 16); break;
+            }
+        }
+        for (unsigned w = 0; w < 4; w++)
+            allocated[w] = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ (uint64_t) rand();
+        allocated[1 + round % 3] = ~0ull;
+        allocated[round % 3] = 0;
+
+        for (unsigned l = 0; l < sizeof(LENGTHS) / sizeof(LENGTHS[0]); l++) {
+            unsigned n = LENGTHS[l];
+            for (unsigned from = 0; from <= n; from++) {
+                for (unsigned s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+
+                    unsigned expected = from;
+                    while (expected < n &&
+                           (sizes[expected] < SIZES[s] || ((allocated[expected / 64] >> (expected % 64)) & 1)))
+                        expected++;
+                    assert_int_equal(mem_search_segments(KERNEL_SCALAR, sizes, allocated,
+                                                         from, n, SIZES[s], &found), ALLOC_OK);
+                    assert_int_equal(found, expected);
+
+                    for (search_kernel k = KERNEL_SSE2; k <= KERNEL_AVX2; k++) {
+                        if (mem_search_segments(k, sizes, allocated, from, n, SIZES[s], &found) == ALLOC_OK)
+                            assert_int_equal(found, expected);
+                    }
+                }
+            }
+        }
+    }
+
+    assert_int_equal(mem_search_segments(KERNEL_SCALAR, sizes, allocated, 0, 0, 0, &found), ALLOC_FAIL);
+    assert_int_equal(mem_search_segments(KERNEL_SCALAR, sizes, allocated, 1, 0, 1, &found), ALLOC_FAIL);
+
+    for (search_kernel k = KERNEL_SSE2; k <= KERNEL_AVX2; k++) {
+        if (mem_search_segments(k, sizes, allocated, 0, 0, 1, &found) == ALLOC_OK) {
+            INFO("Checked the %s kernel against the scalar one\n", KERNEL_NAMES[k]);
+        }
+        else {
+            INFO("The %s kernel isn't supported here\n", KERNEL_NAMES[k]);
+        }
+    }
+}
+
+
+/*******************************************/
+/***         12. BITMAP SCENARIOS        ***/
+/*******************************************/
+
+static int pool_bitmap_setup(void **state) {
+    *state = open_pool(POOL_SIZE, BITMAP, NULL);
+
+    return 0;
+}
+static void test_pool_scenario27(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 27:
+     *
+     * Every allocation takes whole granules of 64 bytes.
+     *
+     * 1. Allocate 100, 64, 1. They take 2, 1 and 1 granules.
+     * 2. Deallocate the 64. Its granule is a gap between allocations.
+     * 3. Allocate 100. It doesn't fit in the gap, so it goes after them.
+     * 4. Allocate 50. It fits in the gap.
+     * 5. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    assert_int_equal(alloc0->size, 128);
+    alloc_pt alloc1 = mem_new_alloc(pool, 64);
+    assert_non_null(alloc1);
+    char *mem2 = mem_new_alloc_addr(pool, 1);
+    assert_true(mem2 == pool->mem + 192);
+
+    pool_segment_t exp1[4] =
+            {
+                    {128, 1},
+                    {64, 1},
+                    {64, 1},
+                    {pool->total_size - 256, 0}
+            };
+    check_pool(pool, exp1);
+    check_metadata(pool, BITMAP, POOL_SIZE, 256, 3, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    pool_segment_t exp2[4] =
+            {
+                    {128, 1},
+                    {64, 0},
+                    {64, 1},
+                    {pool->total_size - 256, 0}
+            };
+    check_pool(pool, exp2);
+    assert_int_equal(pool->num_gaps, 2);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc3);
+    assert_true(alloc3->mem == pool->mem + 256);
+    alloc_pt alloc4 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc4);
+    assert_true(alloc4->mem == pool->mem + 128);
+
+    pool_segment_t exp3[5] =
+            {
+                    {128, 1},
+                    {64, 1},
+                    {64, 1},
+                    {128, 1},
+                    {pool->total_size - 384, 0}
+            };
+    check_pool(pool, exp3);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+
+    check_pool(pool, exp0);
+    check_metadata(pool, BITMAP, POOL_SIZE, 0, 0, 1);
+
+    assert_int_equal(mem_del_alloc_addr(pool, mem2), ALLOC_FAIL);
+}
+
+
+/*******************************************/
+/***       13. WILDERNESS SCENARIOS      ***/
+/*******************************************/
+
+static void test_pool_scenario28(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 28:
+     *
+     * 1. Allocate 1000, 100, and all but the last 200 bytes of the pool.
+     *    Deallocate the 1000.
+     * 2. Allocate 150. The 200 at the end of the pool, which is out of
+     *    the gap index, is the best fit.
+     * 3. Allocate 50. It fills what is left at the end of the pool,
+     *    again the best fit.
+     * 4. Allocate 100. Only the gap at the start of the pool fits.
+     * 5. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 1000);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, pool->total_size - 1300);
+    assert_non_null(alloc2);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc3);
+    assert_true(alloc3->mem == pool->mem + pool->total_size - 200);
+
+    pool_segment_t exp1[5] =
+            {
+                    {1000, 0},
+                    {100, 1},
+                    {pool->total_size - 1300, 1},
+                    {150, 1},
+                    {50, 0}
+            };
+    check_pool(pool, exp1);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc4);
+    assert_true(alloc4->mem == pool->mem + pool->total_size - 50);
+    alloc_pt alloc5 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc5);
+    assert_true(alloc5->mem == pool->mem);
+
+    pool_segment_t exp2[6] =
+            {
+                    {100, 1},
+                    {900, 0},
+                    {100, 1},
+                    {pool->total_size - 1300, 1},
+                    {150, 1},
+                    {50, 1}
+            };
+    check_pool(pool, exp2);
+    check_metadata(pool, BEST_FIT, POOL_SIZE, pool->total_size - 900, 5, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc5), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***       14. QUICK LIST SCENARIOS      ***/
+/*******************************************/
+
+static int pool_quick_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_QUICK_LISTS };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario29(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 29:
+     *
+     * 1. Allocate 100, 50, 100. Deallocate the 50. It goes on a quick
+     *    list instead of becoming a gap.
+     * 2. Allocate 50. It gets the same block back. Deallocating it twice
+     *    fails the second time.
+     * 3. Deallocate the first 100, and allocate the rest of the pool.
+     *    There is no gap left.
+     * 4. Allocate 150. Nothing fits, so the quick lists are coalesced,
+     *    and the 100 and 50 at the start of the pool merge into a gap
+     *    where it fits.
+     * 5. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    char *mem1 = alloc1->mem;
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(pool->num_allocs, 2);
+    assert_int_equal(pool->num_gaps, 1);
+
+    alloc1 = mem_new_alloc(pool, 50);
+    assert_non_null(alloc1);
+    assert_true(alloc1->mem == mem1);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_FAIL);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    alloc_pt alloc3 = mem_new_alloc(pool, pool->total_size - 250);
+    assert_non_null(alloc3);
+    assert_int_equal(pool->num_gaps, 0);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, 150);
+    assert_non_null(alloc4);
+    assert_true(alloc4->mem == pool->mem);
+
+    pool_segment_t exp1[3] =
+            {
+                    {150, 1},
+                    {100, 1},
+                    {pool->total_size - 250, 1}
+            };
+    check_pool(pool, exp1);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, pool->total_size, 3, 0);
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc4), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***        15. ALIGNED SCENARIOS        ***/
+/*******************************************/
+
+static void test_pool_scenario30(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 30:
+     *
+     * 1. Allocate 10. Allocate 100 aligned to 64 bytes. The padding in
+     *    front of it is left as a gap.
+     * 2. Allocate 1000 aligned to a page.
+     * 3. An alignment that isn't a power of 2 is refused.
+     * 4. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 10);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc_aligned(pool, 100, 64);
+    assert_non_null(alloc1);
+    assert_int_equal((size_t) alloc1->mem % 64, 0);
+
+    // the pool is at least 16-byte aligned, so 10 bytes in is never
+    // 64-byte aligned
+    size_t padding = alloc1->mem - (pool->mem + 10);
+    assert_true(padding > 0 && padding < 64);
+
+    pool_segment_t exp1[4] =
+            {
+                    {10, 1},
+                    {padding, 0},
+                    {100, 1},
+                    {pool->total_size - 110 - padding, 0}
+            };
+    check_pool(pool, exp1);
+
+    alloc_pt alloc2 = mem_new_alloc_aligned(pool, 1000, 4096);
+    assert_non_null(alloc2);
+    assert_int_equal((size_t) alloc2->mem % 4096, 0);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 1110, 3,
+                   (alloc2->mem == alloc1->mem + 100) ? 2 : 3);
+
+    assert_null(mem_new_alloc_aligned(pool, 100, 48));
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***         16. RESIZE SCENARIOS        ***/
+/*******************************************/
+
+static void test_pool_scenario31(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 31:
+     *
+     * 1. Allocate 100, 100, 100. Deallocate the middle one.
+     * 2. Resize the first to 150, and then to 200. It grows in place into
+     *    the gap after it, the second time using it up.
+     * 3. Resize the first to 120. Its end is split off into a gap.
+     * 4. Resize the third to 500. It grows in place into the rest of the
+     *    pool.
+     * 5. Resize the first to 300. The gap after it is too small, so it
+     *    moves to the end, with its contents.
+     * 6. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, 100);
+    assert_non_null(alloc2);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    for (int i = 0; i < 100; ++i)
+        alloc0->mem[i] = (char) i;
+
+    assert_true(mem_resize_alloc(pool, alloc0, 150) == alloc0);
+
+    pool_segment_t exp1[4] =
+            {
+                    {150, 1},
+                    {50, 0},
+                    {100, 1},
+                    {pool->total_size - 300, 0}
+            };
+    check_pool(pool, exp1);
+
+    assert_true(mem_resize_alloc(pool, alloc0, 200) == alloc0);
+    assert_true(mem_resize_alloc(pool, alloc0, 120) == alloc0);
+    assert_true(mem_resize_alloc(pool, alloc2, 500) == alloc2);
+
+    pool_segment_t exp2[4] =
+            {
+                    {120, 1},
+                    {80, 0},
+                    {500, 1},
+                    {pool->total_size - 700, 0}
+            };
+    check_pool(pool, exp2);
+
+    alloc_pt alloc3 = mem_resize_alloc(pool, alloc0, 300);
+    assert_non_null(alloc3);
+    assert_true(alloc3->mem == pool->mem + 700);
+    for (int i = 0; i < 100; ++i)
+        assert_int_equal(alloc3->mem[i], (char) i);
+
+    pool_segment_t exp3[4] =
+            {
+                    {200, 0},
+                    {500, 1},
+                    {300, 1},
+                    {pool->total_size - 1000, 0}
+            };
+    check_pool(pool, exp3);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 800, 2, 2);
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***       17. HUGE PAGE SCENARIOS       ***/
+/*******************************************/
+
+static int pool_huge_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_HUGE_PAGES };
+
+    *state = open_pool(3 * POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario32(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 32:
+     *
+     * 1. The pool is backed by huge pages if the system has them, and
+     *    then starts on a 2 MiB boundary, else by normal pages.
+     * 2. Allocate a third of the pool twice, and write all of it.
+     * 3. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    INFO("Pool backing is %d\n", pool->backing);
+    assert_int_equal(pool->total_size, 3 * POOL_SIZE);
+    if (pool->backing == BACKING_THP_ADVISED || pool->backing == BACKING_HUGETLB)
+        assert_int_equal((size_t) pool->mem % (2 << 20), 0);
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, POOL_SIZE);
+    assert_non_null(alloc1);
+    for (unsigned i = 0; i < POOL_SIZE; ++i) {
+        alloc0->mem[i] = (char) i;
+        alloc1->mem[i] = (char) ~i;
+    }
+
+    pool_segment_t exp1[3] =
+            {
+                    {POOL_SIZE, 1},
+                    {POOL_SIZE, 1},
+                    {POOL_SIZE, 0}
+            };
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***       18. GROWABLE SCENARIOS        ***/
+/*******************************************/
+
+static int pool_growable_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_GROWABLE };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario33(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 33:
+     *
+     * 1. Allocate the whole pool. Pool has no gaps.
+     * 2. Allocate half the pool size. The pool maps another arena, of the
+     *    size it was opened with, and doubles.
+     * 3. Allocate three times the pool size. The pool maps an arena of
+     *    just that size, and write all of it.
+     * 4. Deallocate the last allocation, and trim. Its arena is unmapped.
+     * 5. Deallocate the rest, and trim. Pool is again one single gap, of
+     *    the size it was opened with.
+     *
+     * (the arenas are mapped wherever the system has room, so only the
+     * totals are checked until the pool is back to one arena)
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {POOL_SIZE, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE);
+    assert_non_null(alloc0);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, POOL_SIZE, 1, 0);
+
+    alloc_pt alloc1 = mem_new_alloc(pool, POOL_SIZE / 2);
+    assert_non_null(alloc1);
+    check_metadata(pool, FIRST_FIT, 2 * POOL_SIZE, POOL_SIZE + POOL_SIZE / 2, 2, 1);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, 3 * POOL_SIZE);
+    assert_non_null(alloc2);
+    check_metadata(pool, FIRST_FIT, 5 * POOL_SIZE, 4 * POOL_SIZE + POOL_SIZE / 2, 3, 1);
+    for (unsigned i = 0; i < 3 * POOL_SIZE; ++i)
+        alloc2->mem[i] = (char) i;
+
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, 5 * POOL_SIZE, POOL_SIZE + POOL_SIZE / 2, 2, 2);
+    assert_int_equal(mem_pool_trim(pool), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, 2 * POOL_SIZE, POOL_SIZE + POOL_SIZE / 2, 2, 1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, 2 * POOL_SIZE, 0, 0, 2);
+    assert_int_equal(mem_pool_trim(pool), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***        19. RESERVE SCENARIOS        ***/
+/*******************************************/
+
+static int pool_reserve_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { POOL_RESERVE, .reserve_size = 8 * POOL_SIZE };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario34(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 34:
+     *
+     * 1. Allocate half the pool twice. Pool has no gaps.
+     * 2. Allocate a quarter of the pool size. The pool doubles in place,
+     *    and the allocation starts right where the pool used to end.
+     * 3. Allocate five times the pool size. The gap at the end grows by
+     *    what it lacks, and write all of it.
+     * 4. Allocate twice the pool size, more than is left of the
+     *    reservation. Allocation fails.
+     * 5. Deallocate everything. Pool is one single gap, of all it grew to.
+     */
+
+    char *mem = pool->mem;
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE / 2);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, POOL_SIZE / 2);
+    assert_non_null(alloc1);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, POOL_SIZE, 2, 0);
+
+    alloc_pt alloc2 = mem_new_alloc(pool, POOL_SIZE / 4);
+    assert_non_null(alloc2);
+    assert_true(pool->mem == mem);
+    assert_true(alloc2->mem == mem + POOL_SIZE);
+
+    pool_segment_t exp1[4] =
+            {
+                    {POOL_SIZE / 2, 1},
+                    {POOL_SIZE / 2, 1},
+                    {POOL_SIZE / 4, 1},
+                    {POOL_SIZE - POOL_SIZE / 4, 0}
+            };
+    check_pool(pool, exp1);
+
+    alloc_pt alloc3 = mem_new_alloc(pool, 5 * POOL_SIZE);
+    assert_non_null(alloc3);
+    for (unsigned i = 0; i < 5 * POOL_SIZE; ++i)
+        alloc3->mem[i] = (char) i;
+
+    pool_segment_t exp2[4] =
+            {
+                    {POOL_SIZE / 2, 1},
+                    {POOL_SIZE / 2, 1},
+                    {POOL_SIZE / 4, 1},
+                    {5 * POOL_SIZE, 1}
+            };
+    check_pool(pool, exp2);
+
+    alloc_pt alloc4 = mem_new_alloc(pool, 2 * POOL_SIZE);
+    assert_null(alloc4);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc3), ALLOC_OK);
+
+    pool_segment_t exp3[1] =
+            {
+                    {6 * POOL_SIZE + POOL_SIZE / 4, 0}
+            };
+    check_pool(pool, exp3);
+}
+
+
+/*******************************************/
+/***          20. TRIM SCENARIOS         ***/
+/*******************************************/
+
+static int pool_trim_setup(void **state) {
+    const pool_options_t POOL_OPTIONS = { .trim_threshold = POOL_SIZE / 2 };
+
+    *state = open_pool(POOL_SIZE, FIRST_FIT, &POOL_OPTIONS);
+
+    return 0;
+}
+
+static void test_pool_scenario35(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 35:
+     *
+     * 1. Allocate a quarter, a half and a quarter of the pool, and write
+     *    all of it.
+     * 2. Deallocate the half. The gap is as large as the trim threshold,
+     *    so its pages are released as it forms. On Linux, the inside of
+     *    the gap reads as zeros.
+     * 3. Allocate the half again, zeroed. It reads as zeros.
+     * 4. Deallocate the first quarter, which is below the threshold, and
+     *    trim. On Linux, the inside of the gap reads as zeros. Allocate it
+     *    again, zeroed. It reads as zeros.
+     * 5. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {POOL_SIZE, 0}
+            };
+
+    alloc_pt alloc0 = mem_new_alloc(pool, POOL_SIZE / 4);
+    assert_non_null(alloc0);
+    alloc_pt alloc1 = mem_new_alloc(pool, POOL_SIZE / 2);
+    assert_non_null(alloc1);
+    alloc_pt alloc2 = mem_new_alloc(pool, POOL_SIZE / 4);
+    assert_non_null(alloc2);
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        pool->mem[i] = (char) 0xab;
+
+    char *mem1 = alloc1->mem;
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+#ifdef __linux__
+    for (unsigned i = 3 * POOL_SIZE / 8; i < 5 * POOL_SIZE / 8; ++i)
+        assert_int_equal(pool->mem[i], 0);
+#endif
+
+    alloc1 = mem_new_alloc_zeroed(pool, POOL_SIZE / 2);
+    assert_non_null(alloc1);
+    assert_true(alloc1->mem == mem1);
+    for (unsigned i = 0; i < POOL_SIZE / 2; ++i)
+        assert_int_equal(alloc1->mem[i], 0);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_pool_trim(pool), ALLOC_OK);
+#ifdef __linux__
+    for (unsigned i = POOL_SIZE / 16; i < 3 * POOL_SIZE / 16; ++i)
+        assert_int_equal(pool->mem[i], 0);
+#endif
+
+    alloc0 = mem_new_alloc_zeroed(pool, POOL_SIZE / 4);
+    assert_non_null(alloc0);
+    assert_true(alloc0->mem == pool->mem);
+    for (unsigned i = 0; i < POOL_SIZE / 4; ++i)
+        assert_int_equal(alloc0->mem[i], 0);
+
+    pool_segment_t exp1[3] =
+            {
+                    {POOL_SIZE / 4, 1},
+                    {POOL_SIZE / 2, 1},
+                    {POOL_SIZE / 4, 1}
+            };
+    check_pool(pool, exp1);
+
+    assert_int_equal(mem_del_alloc(pool, alloc0), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc1), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, alloc2), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***       21. GAP INDEX SCENARIOS       ***/
+/*******************************************/
+
+static void test_pool_scenario36(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 36:
+     *
+     * 1. Allocate 100 ten times. The rest of the pool is one gap.
+     * 2. Deallocate the second and the ninth. Deallocate the fifth,
+     *    which lies between two allocations, with the nearest gaps three
+     *    allocations away on either side. It is a gap of its own.
+     * 3. Allocate 100 three times. The gaps are taken in address order,
+     *    the fifth one second.
+     * 4. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt allocs[10];
+    for (unsigned u = 0; u < 10; u++) {
+        allocs[u] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[u]);
+        assert_true(allocs[u]->mem == pool->mem + 100 * u);
+    }
+
+    assert_int_equal(mem_del_alloc(pool, allocs[1]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[8]), ALLOC_OK);
+    assert_int_equal(mem_del_alloc(pool, allocs[4]), ALLOC_OK);
+
+    pool_segment_t exp1[11] =
+            {
+                    {100, 1}, {100, 0}, {100, 1}, {100, 1}, {100, 0},
+                    {100, 1}, {100, 1}, {100, 1}, {100, 0}, {100, 1},
+                    {pool->total_size - 1000, 0}
+            };
+    check_pool(pool, exp1);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 700, 7, 4);
+
+    const unsigned FREED[3] = { 1, 4, 8 };
+    for (unsigned u = 0; u < 3; u++) {
+        allocs[FREED[u]] = mem_new_alloc(pool, 100);
+        assert_non_null(allocs[FREED[u]]);
+        assert_true(allocs[FREED[u]]->mem == pool->mem + 100 * FREED[u]);
+    }
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 1000, 10, 1);
+
+    for (unsigned u = 0; u < 10; u++)
+        assert_int_equal(mem_del_alloc(pool, allocs[u]), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+static void test_pool_scenario37(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 37:
+     *
+     * 1. Allocate 64 blocks of varied sizes, each followed by an 8-byte
+     *    separator. Deallocate the blocks in a scattered order, leaving
+     *    64 gaps of varied sizes. The gap index stays balanced, and its
+     *    heights and max sizes up to date, after each insertion.
+     * 2. Allocate 64 blocks of varied sizes, which split or take whole
+     *    gaps, and deallocate every third separator, which merges the
+     *    gaps around it. The index stays valid after each change.
+     * 3. Deallocate everything. Pool is again one single gap.
+     * 4. Leave gaps of 100, 100, 100, 90 and 100 bytes, separated by
+     *    allocations, and deallocated highest first. Allocate 90: it takes
+     *    the exact fit. Allocate 100, 95, 100, 100: of the gaps of equal
+     *    size, the lowest-address one is taken each time.
+     * 5. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt blocks[64], seps[64], more[64];
+    for (unsigned u = 0; u < 64; u++) {
+        blocks[u] = mem_new_alloc(pool, 50 + (u * 29) % 100);
+        assert_non_null(blocks[u]);
+        seps[u] = mem_new_alloc(pool, 8);
+        assert_non_null(seps[u]);
+    }
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+
+    for (unsigned k = 0; k < 64; k++) {
+        assert_int_equal(mem_del_alloc(pool, blocks[(k * 37) % 64]), ALLOC_OK);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    }
+    assert_int_equal(pool->num_gaps, 65);
+
+    for (unsigned k = 0; k < 64; k++) {
+        more[k] = mem_new_alloc(pool, 40 + (k * 13) % 70);
+        assert_non_null(more[k]);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+        if (k % 3 == 0) {
+            assert_int_equal(mem_del_alloc(pool, seps[k]), ALLOC_OK);
+            seps[k] = NULL;
+            assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+        }
+    }
+
+    for (unsigned u = 0; u < 64; u++) {
+        assert_int_equal(mem_del_alloc(pool, more[u]), ALLOC_OK);
+        if (seps[u] != NULL)
+            assert_int_equal(mem_del_alloc(pool, seps[u]), ALLOC_OK);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    }
+    check_pool(pool, exp0);
+
+    const size_t SIZES[5] = { 100, 100, 100, 90, 100 };
+    for (unsigned u = 0; u < 5; u++) {
+        blocks[u] = mem_new_alloc(pool, SIZES[u]);
+        assert_non_null(blocks[u]);
+        seps[u] = mem_new_alloc(pool, 8);
+        assert_non_null(seps[u]);
+    }
+    for (unsigned u = 5; u-- > 0; )
+        assert_int_equal(mem_del_alloc(pool, blocks[u]), ALLOC_OK);
+
+    pool_segment_t exp1[11] =
+            {
+                    {100, 0}, {8, 1}, {100, 0}, {8, 1}, {100, 0}, {8, 1},
+                    {90, 0}, {8, 1}, {100, 0}, {8, 1},
+                    {pool->total_size - 530, 0}
+            };
+    check_pool(pool, exp1);
+
+    more[0] = mem_new_alloc(pool, 90);
+    assert_true(more[0]->mem == pool->mem + 324);
+    more[1] = mem_new_alloc(pool, 100);
+    assert_true(more[1]->mem == pool->mem);
+    more[2] = mem_new_alloc(pool, 95);
+    assert_true(more[2]->mem == pool->mem + 108);
+    more[3] = mem_new_alloc(pool, 100);
+    assert_true(more[3]->mem == pool->mem + 216);
+    more[4] = mem_new_alloc(pool, 100);
+    assert_true(more[4]->mem == pool->mem + 422);
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 525, 10, 2);
+
+    for (unsigned u = 0; u < 5; u++) {
+        assert_int_equal(mem_del_alloc(pool, more[u]), ALLOC_OK);
+        assert_int_equal(mem_del_alloc(pool, seps[u]), ALLOC_OK);
+    }
+
+    check_pool(pool, exp0);
+}
+
+
+static void test_pool_scenario38(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 38:
+     *
+     * 1. Allocate 96 blocks of varied sizes, each followed by an 8-byte
+     *    separator, and deallocate the blocks in a scattered order.
+     * 2. Allocate blocks of varied sizes, deallocating every third one
+     *    again. Each allocation is at the lowest-address gap that fits,
+     *    as found by going through the segments of the pool, so the max
+     *    sizes the search descends by are right. The index stays valid
+     *    after each change.
+     * 3. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt blocks[96], seps[96], more[96];
+    for (unsigned u = 0; u < 96; u++) {
+        blocks[u] = mem_new_alloc(pool, 20 + (u * 53) % 200);
+        assert_non_null(blocks[u]);
+        seps[u] = mem_new_alloc(pool, 8);
+        assert_non_null(seps[u]);
+    }
+    for (unsigned k = 0; k < 96; k++) {
+        assert_int_equal(mem_del_alloc(pool, blocks[(k * 41) % 96]), ALLOC_OK);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    }
+
+    for (unsigned k = 0; k < 96; k++) {
+        size_t size = 10 + (k * 67) % 230;
+
+        // the lowest-address gap that fits, the one at the end if no other
+        pool_segment_pt segs = NULL;
+        unsigned num_segs = 0;
+        mem_inspect_pool(pool, &segs, &num_segs);
+        size_t offset = 0;
+        for (unsigned u = 0; u < num_segs; u++) {
+            if (!segs[u].allocated && segs[u].size >= size)
+                break;
+            offset += segs[u].size;
+        }
+        free(segs);
+
+        more[k] = mem_new_alloc(pool, size);
+        assert_non_null(more[k]);
+        assert_true(more[k]->mem == pool->mem + offset);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+
+        if (k % 3 == 2) {
+            assert_int_equal(mem_del_alloc(pool, more[k]), ALLOC_OK);
+            more[k] = NULL;
+            assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+        }
+    }
+
+    for (unsigned u = 0; u < 96; u++) {
+        if (more[u] != NULL)
+            assert_int_equal(mem_del_alloc(pool, more[u]), ALLOC_OK);
+        assert_int_equal(mem_del_alloc(pool, seps[u]), ALLOC_OK);
+    }
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+static void test_pool_scenario39(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 39:
+     *
+     * 1. Allocate 32 blocks of different sizes, each followed by an 8-byte
+     *    separator, and deallocate the blocks, leaving 32 gaps.
+     * 2. Deallocate the separators in a scattered order. Each merges the
+     *    gaps on both sides of it, whose index entries are found through
+     *    their nodes and removed, moving other entries around the index
+     *    array. Every gap node still points at its own entry after each
+     *    merge.
+     * 3. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt blocks[32], seps[32];
+    for (unsigned u = 0; u < 32; u++) {
+        blocks[u] = mem_new_alloc(pool, 100 + u);
+        assert_non_null(blocks[u]);
+        seps[u] = mem_new_alloc(pool, 8);
+        assert_non_null(seps[u]);
+    }
+    for (unsigned u = 0; u < 32; u++)
+        assert_int_equal(mem_del_alloc(pool, blocks[u]), ALLOC_OK);
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    check_metadata(pool, BEST_FIT, POOL_SIZE, 256, 32, 33);
+
+    for (unsigned k = 0; k < 32; k++) {
+        assert_int_equal(mem_del_alloc(pool, seps[(k * 13) % 32]), ALLOC_OK);
+        assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+        assert_int_equal(pool->num_gaps, 32 - k);
+    }
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***       22. NODE HEAP SCENARIOS       ***/
+/*******************************************/
+
+static void test_pool_scenario40(void **state) {
+    pool_pt pool = *state;
+
+    /*
+     * Scenario 40:
+     *
+     * 1. Allocate 16 bytes 200 times, which takes several chunks of
+     *    nodes. The allocation records made before stay where they are,
+     *    and unchanged, as the node heap grows.
+     * 2. Deallocate every other allocation, and then the rest. The pool
+     *    is again one single gap.
+     * 3. Allocate 16 bytes 200 times again. Every allocation record is
+     *    one of the nodes given back, so the node heap doesn't grow: the
+     *    nodes of the allocations, and the one that held the gap at the
+     *    end of the pool.
+     * 4. Deallocate everything. Pool is again one single gap.
+     */
+
+    pool_segment_t exp0[1] =
+            {
+                    {pool->total_size, 0}
+            };
+
+    alloc_pt allocs[200], again[200];
+    for (unsigned u = 0; u < 200; u++) {
+        allocs[u] = mem_new_alloc(pool, 16);
+        assert_non_null(allocs[u]);
+        for (unsigned v = 0; v <= u; v++) {
+            assert_int_equal(allocs[v]->size, 16);
+            assert_true(allocs[v]->mem == pool->mem + 16 * v);
+        }
+    }
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    check_metadata(pool, FIRST_FIT, POOL_SIZE, 3200, 200, 1);
+
+    for (unsigned u = 0; u < 200; u += 2)
+        assert_int_equal(mem_del_alloc(pool, allocs[u]), ALLOC_OK);
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+    for (unsigned u = 1; u < 200; u += 2)
+        assert_int_equal(mem_del_alloc(pool, allocs[u]), ALLOC_OK);
+    check_pool(pool, exp0);
+
+    unsigned num_other = 0;
+    for (unsigned u = 0; u < 200; u++) {
+        again[u] = mem_new_alloc(pool, 16);
+        assert_non_null(again[u]);
+        unsigned v = 0;
+        while (v < 200 && allocs[v] != again[u])
+            v++;
+        num_other += (v == 200);
+    }
+    assert_true(num_other <= 1);
+    assert_int_equal(mem_check_pool(pool), ALLOC_OK);
+
+    for (unsigned u = 0; u < 200; u++)
+        assert_int_equal(mem_del_alloc(pool, again[u]), ALLOC_OK);
+
+    check_pool(pool, exp0);
+}
+
+
+/*******************************************/
+/***         23. STRESS TEST             ***/
+/*******************************************/
+
+void test_pool_stresstest(void **state) {
+    (void) state; /* unused */
+
+    const unsigned num_pools = 200;
+    const unsigned num_allocations = 1000;
+    const unsigned min_alloc_size = 10;
+    const unsigned pool_size =
+            (num_allocations / 2) *
+            (2 * min_alloc_size + (num_allocations - 1) * min_alloc_size);
+    assert_int_equal(pool_size, 5005000);
+
+
+    pool_pt pools[num_pools];
+    alloc_pt allocations[num_pools][num_allocations];
+
+    /*
+     * NOTE: This works because the node heap grows by adding
+     * chunks of nodes, and never moves the ones it has. Since
+     * allocation records are a part of the nodes, their addresses,
+     * which are returned to the user, stay valid as the pool grows.
+     */
+
+    /*
+     * Testing dynamic reallocation of pool structures:
+     *
+     * 1. 200 pools of 5005000 each (many pools)
+     * 2. In each pool 1000 allocations of different sizes (many allocations)
+     * 3. In each pool 500 deallocations (many gaps)
+     */
+
+    // initialize store
+    assert_int_equal(mem_init(), ALLOC_OK);
+
+    // allocate pools
+    for (unsigned pix=0; pix < num_pools; ++pix) {
+        // open pool
+        pools[pix] =
+                mem_pool_open(pool_size, (pix % 2) ? FIRST_FIT : BEST_FIT);
+        assert_non_null(pools[pix]);
+        // allocate pool
+        unsigned allocated = 0;
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            allocations[pix][aix] =
+                    mem_new_alloc(pools[pix], (aix + 1) * min_alloc_size);
+            allocated += (aix + 1) * min_alloc_size;
+            if (!allocations[pix][aix]) {
+                INFO("ASSERT WILL FAIL at pix = %u, aix = %u, allocated = %u\n", pix, aix, allocated);
+            }
+            assert_non_null(allocations[pix][aix]);
+        }
+        // delete every other allocation
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            if (aix % 2) {
+                assert_int_equal(
+                        mem_del_alloc(pools[pix], allocations[pix][aix]),
+                        ALLOC_OK);
+                allocations[pix][aix] = NULL;
+            }
+        }
+    }
+
+    // delete pools
+    for (unsigned pix=0; pix < num_pools; ++pix) {
+        // delete pool's allocations
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            if (allocations[pix][aix]) {
+                // delete allocation
+                assert_int_equal(
+                    mem_del_alloc(pools[pix], allocations[pix][aix]),
+                    ALLOC_OK);
+            }
+        }
+        // close pool
+        assert_int_equal(mem_pool_close(pools[pix]), ALLOC_OK);
+    }
+
+    // free store
+    assert_int_equal(mem_free(), ALLOC_OK);
+}
+
+static void test_pool_stresstest_addr(void **state) {
+    (void) state; /* unused */
+
+    const unsigned num_pools = 200;
+    const unsigned num_allocations = 1000;
+    const unsigned min_alloc_size = 10;
+    const unsigned pool_size =
+            (num_allocations / 2) *
+            (2 * min_alloc_size + (num_allocations - 1) * min_alloc_size);
+    assert_int_equal(pool_size, 5005000);
+
+
+    pool_pt pools[num_pools];
+    char *allocations[num_pools][num_allocations];
+
+    /*
+     * Same as the stress test above, but through the address API,
+     * which hands out the (stable) allocation addresses in the pool.
+     */
+
+    // initialize store
+    assert_int_equal(mem_init(), ALLOC_OK);
+
+    // allocate pools
+    for (unsigned pix=0; pix < num_pools; ++pix) {
+        // open pool
+        pools[pix] =
+                mem_pool_open(pool_size, (pix % 2) ? FIRST_FIT : BEST_FIT);
+        assert_non_null(pools[pix]);
+        // allocate pool
+        char *expected = pools[pix]->mem;
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            allocations[pix][aix] =
+                    mem_new_alloc_addr(pools[pix], (aix + 1) * min_alloc_size);
+            assert_true(allocations[pix][aix] == expected);
+            expected += (aix + 1) * min_alloc_size;
+        }
+        // delete every other allocation
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            if (aix % 2) {
+                assert_int_equal(
+                        mem_del_alloc_addr(pools[pix], allocations[pix][aix]),
+                        ALLOC_OK);
+                // a second delete has nothing to find
+                assert_int_equal(
+                        mem_del_alloc_addr(pools[pix], allocations[pix][aix]),
+                        ALLOC_FAIL);
+                allocations[pix][aix] = NULL;
+            }
+        }
+        assert_int_equal(pools[pix]->num_allocs, num_allocations / 2);
+        assert_int_equal(pools[pix]->num_gaps, num_allocations / 2);
+    }
+
+    // delete pools
+    for (unsigned pix=0; pix < num_pools; ++pix) {
+        // delete pool's allocations
+        for (unsigned aix=0; aix < num_allocations; ++aix) {
+            if (allocations[pix][aix]) {
+                // delete allocation
+                assert_int_equal(
+                    mem_del_alloc_addr(pools[pix], allocations[pix][aix]),
+                    ALLOC_OK);
+            }
+        }
+        assert_int_equal(pools[pix]->num_allocs, 0);
+        assert_int_equal(pools[pix]->num_gaps, 1);
+        // close pool
+        assert_int_equal(mem_pool_close(pools[pix]), ALLOC_OK);
+    }
+
+    // free store
+    assert_int_equal(mem_free(), ALLOC_OK);
+}
+
+
+/*******************************************/
+/***        24. DRIVER ROUTINE           ***/
+/*******************************************/
+
+int run_test_suite() {
+    const struct CMUnitTest tests[] = {
+            cmocka_unit_test(test_pool_store_smoketest),
+            cmocka_unit_test(test_pool_smoketest),
 
             cmocka_unit_test(test_pool_nonempty),
 
-            cmocka_unit_test_setup_teardown(test_pool_ff_metadata, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_bf_metadata, pool_bf_setup, pool_bf_teardown),
-
-            cmocka_unit_test_setup_teardown(test_pool_scenario00, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario01, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario02, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario03, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario04, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario05, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario06, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario07, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario08, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario09, pool_ff_setup, pool_ff_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario10, pool_ff_setup, pool_ff_teardown),
-
-            cmocka_unit_test_setup_teardown(test_pool_scenario11, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario12, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario13, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario14, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario15, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario16, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario17, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario18, pool_bf_setup, pool_bf_teardown),
-            cmocka_unit_test_setup_teardown(test_pool_scenario19, pool_bf_setup, pool_bf_teardown),
-
-            // do not uncomment until the project is changed to return the allocation address
-//            cmocka_unit_test(test_pool_stresstest),
+            cmocka_unit_test_setup_teardown(test_pool_ff_metadata, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_bf_metadata, pool_bf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario00, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario01, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario02, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario03, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario04, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario05, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario06, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario07, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario08, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario09, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario10, pool_ff_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario11, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario12, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario13, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario14, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario15, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario16, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario17, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario18, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario19, pool_bf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario20, pool_sf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario21, pool_tlsf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario22, pool_buddy_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario23, pool_tags_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario24, pool_slab_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario25, pool_nf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario26, pool_compact_setup, pool_teardown),
+            cmocka_unit_test(test_search_kernels),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario27, pool_bitmap_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario28, pool_bf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario29, pool_quick_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario30, pool_ff_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario31, pool_ff_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario32, pool_huge_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario33, pool_growable_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario34, pool_reserve_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario35, pool_trim_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario36, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario37, pool_bf_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario38, pool_ff_setup, pool_teardown),
+            cmocka_unit_test_setup_teardown(test_pool_scenario39, pool_bf_setup, pool_teardown),
+
+            cmocka_unit_test_setup_teardown(test_pool_scenario40, pool_ff_setup, pool_teardown),
+
+            cmocka_unit_test(test_pool_stresstest),
+            cmocka_unit_test(test_pool_stresstest_addr),
     };
 
     return cmocka_run_group_tests_name("pool_test_suite", tests, NULL, NULL);
 }
 
 /* future editions */
-// TODO stress test: many pools, many allocations, many gaps (requires project refactoring, see NOTE in test body)
 // TODO test memory leaks: any way to do it w/o having to rewrite the source file?
 // TODO fix the final PASSED line of std::cerr output to the end of the file (?)